@@ -0,0 +1,94 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_BENCHES_BENCH_H
+#define Y_BENCHES_BENCH_H
+
+#include <y/core/Chrono.h>
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+
+namespace y {
+namespace bench {
+
+static constexpr double min_bench_time = 1.0;
+
+// Prevents the compiler from removing computations whose result is otherwise unused
+template<typename T>
+volatile T keep_sink = {};
+
+template<typename T>
+void keep(T value) {
+	keep_sink<T> = value;
+}
+
+static void print(const char* name, const core::String& result) {
+	core::String line = fmt("    %", name);
+	while(line.size() < 48) {
+		line += " ";
+	}
+	line += result;
+	log_msg(line, Log::Perf);
+}
+
+struct Measure {
+	usize items = 0;
+	usize runs = 0;
+	double secs = 0.0;
+
+	double per_sec() const {
+		return items / secs;
+	}
+};
+
+// func() runs the benchmark once and returns the number of processed items
+template<typename F>
+Measure measure(F&& func) {
+	Measure m;
+	core::Chrono chrono;
+	do {
+		m.items += func();
+		++m.runs;
+	} while(chrono.elapsed().to_secs() < min_bench_time);
+	m.secs = chrono.elapsed().to_secs();
+	return m;
+}
+
+template<typename F>
+double run(const char* name, const char* unit, F&& func) {
+	const Measure m = measure(func);
+	print(name, fmt("% %/s (% runs)", usize(m.per_sec()), unit, m.runs));
+	return m.per_sec();
+}
+
+// Also reports the throughput, for a benchmark that processes run_bytes bytes per run
+template<typename F>
+double run(const char* name, const char* unit, usize run_bytes, F&& func) {
+	const Measure m = measure(func);
+	const double mb_per_sec = (double(run_bytes) * m.runs / m.secs) / (1024.0 * 1024.0);
+	print(name, fmt("% MB/s, % %/s (% runs)", usize(mb_per_sec), usize(m.per_sec()), unit, m.runs));
+	return m.per_sec();
+}
+
+}
+}
+
+#endif // Y_BENCHES_BENCH_H
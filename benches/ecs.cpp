@@ -0,0 +1,206 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "bench.h"
+
+#include <y/ecs/EntityWorld.h>
+#include <y/io2/Buffer.h>
+
+using namespace y;
+using namespace y::ecs;
+
+template<usize N>
+struct Comp {
+	u32 value = N;
+};
+
+static constexpr usize type_count = 8;
+static constexpr usize entity_count = 100000;
+
+template<usize... I>
+static void add_components(EntityWorld& world, EntityID id, usize mask, std::index_sequence<I...>) {
+	((mask & (usize(1) << I) ? world.add_component<Comp<I>>(id) : void()), ...);
+}
+
+template<usize... I>
+static void toggle_component(EntityWorld& world, EntityID id, usize index, bool add, std::index_sequence<I...>) {
+	((I == index ? (add ? world.add_component<Comp<I>>(id) : world.remove_component<Comp<I>>(id)) : void()), ...);
+}
+
+// One entity in each of the 2^type_count archetypes
+static void create_all_archetypes(EntityWorld& world) {
+	for(usize mask = 1; mask != (usize(1) << type_count); ++mask) {
+		add_components(world, world.create_entity(), mask, std::make_index_sequence<type_count>());
+	}
+}
+
+static void bench_transitions() {
+	EntityWorld world;
+	create_all_archetypes(world);
+
+	// The entity is always the last one of its archetypes, so transitions never need to patch other entities
+	const EntityID id = world.create_entity();
+	world.add_component<Comp<0>>(id);
+
+	bench::run("add/remove component (256 archetypes)", "transitions", [&] {
+		static constexpr usize rounds = 10000;
+		for(usize r = 0; r != rounds; ++r) {
+			for(usize i = 1; i != type_count; ++i) {
+				toggle_component(world, id, i, true, std::make_index_sequence<type_count>());
+			}
+			for(usize i = 1; i != type_count; ++i) {
+				toggle_component(world, id, i, false, std::make_index_sequence<type_count>());
+			}
+		}
+		return rounds * (type_count - 1) * 2;
+	});
+}
+
+template<typename... Args>
+static void create_entities(EntityWorld& world, usize count) {
+	for(usize i = 0; i != count; ++i) {
+		world.add_components<Args...>(world.create_entity());
+	}
+}
+
+static usize allocated_bytes(const EntityWorld& world) {
+	usize bytes = world.entity_ids().size() * sizeof(EntityData);
+	for(const auto& arc : world.archetypes()) {
+		bytes += arc->allocated_bytes();
+	}
+	return bytes;
+}
+
+template<typename... Args>
+static void bench_create(const char* name) {
+	usize bytes = 0;
+	bench::run(name, "entities", [&] {
+		EntityWorld world;
+		create_entities<Args...>(world, entity_count);
+		bytes = allocated_bytes(world);
+		return entity_count;
+	});
+	bench::print("    memory", fmt("% bytes/entity", double(bytes) / entity_count));
+}
+
+template<typename... Args>
+static void bench_view(const char* name) {
+	EntityWorld world;
+	create_entities<Comp<0>, Comp<1>, Comp<2>, Comp<3>>(world, entity_count);
+
+	u32 sum = 0;
+	bench::run(name, "entities", [&] {
+		for(const auto& components : world.view<const Args...>()) {
+			std::apply([&](const auto&... c) { sum += (c.value + ...); }, components);
+		}
+		return entity_count;
+	});
+	bench::keep(sum);
+}
+
+static void bench_add_components() {
+	bench::run("add_components<2> (100k entities)", "entities", [&] {
+		EntityWorld world;
+		create_entities<Comp<0>>(world, entity_count);
+		for(const EntityID id : world.entity_ids()) {
+			world.add_components<Comp<1>, Comp<2>>(id);
+		}
+		return entity_count;
+	});
+}
+
+static void bench_remove_churn() {
+	EntityWorld world;
+	create_entities<Comp<0>, Comp<1>>(world, entity_count);
+
+	// Removes every other entity and creates them back, through the free list
+	bench::run("remove_entity churn (100k entities)", "entities", [&] {
+		const core::Vector<EntityID> ids(world.entity_ids());
+		for(usize i = 0; i < ids.size(); i += 2) {
+			world.remove_entity(ids[i]);
+		}
+		create_entities<Comp<0>, Comp<1>>(world, (ids.size() + 1) / 2);
+		return ids.size();
+	});
+}
+
+static void bench_fragmented() {
+	EntityWorld world;
+	for(usize i = 0; i != entity_count / 256; ++i) {
+		create_all_archetypes(world);
+	}
+	const usize count = world.entity_ids().size();
+
+	u32 sum = 0;
+	bench::run("view<1> (256 archetypes)", "entities", [&] {
+		for(const auto& [c] : world.view<const Comp<0>>()) {
+			sum += c.value;
+		}
+		return count;
+	});
+	bench::keep(sum);
+	bench::print("    memory", fmt("% bytes/entity", double(allocated_bytes(world)) / count));
+}
+
+static void bench_snapshot() {
+	EntityWorld world;
+	create_entities<Comp<0>, Comp<1>, Comp<2>>(world, entity_count);
+
+	io2::Buffer buffer;
+	bench::run("save (100k entities)", "entities", [&] {
+		buffer.clear();
+		if(!world.save(buffer)) {
+			y_fatal("Save failed.");
+		}
+		return entity_count;
+	});
+	bench::print("    snapshot", fmt("% bytes/entity", double(buffer.size()) / entity_count));
+
+	bench::run("load (100k entities)", "entities", [&] {
+		buffer.reset();
+		EntityWorld loaded;
+		if(!loaded.load(buffer)) {
+			y_fatal("Load failed.");
+		}
+		return entity_count;
+	});
+}
+
+int main() {
+	log_msg("ECS:", Log::Perf);
+	bench_create<Comp<0>>("create<1> (100k entities)");
+	bench_create<Comp<0>, Comp<1>>("create<2> (100k entities)");
+	bench_create<Comp<0>, Comp<1>, Comp<2>, Comp<3>>("create<4> (100k entities)");
+
+	bench_view<Comp<0>>("view<1>");
+	bench_view<Comp<0>, Comp<1>>("view<2>");
+	bench_view<Comp<0>, Comp<1>, Comp<2>>("view<3>");
+	bench_view<Comp<0>, Comp<1>, Comp<2>, Comp<3>>("view<4>");
+
+	bench_add_components();
+	bench_remove_churn();
+	bench_fragmented();
+	bench_snapshot();
+	bench_transitions();
+
+	return 0;
+}
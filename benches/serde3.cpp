@@ -0,0 +1,253 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "bench.h"
+
+#include <y/serde3/archives.h>
+#include <y/core/String.h>
+#include <y/core/HashMap.h>
+#include <y/io2/Buffer.h>
+#include <y/io2/File.h>
+
+#include <cstdio>
+
+using namespace y;
+
+void write_legacy_samples(io2::Buffer& buffer, usize count);
+
+namespace {
+
+struct Node {
+	u32 id = 0;
+	float weight = 0.0f;
+	core::String name;
+	core::Vector<Node> children;
+
+	y_serde3(id, weight, name, children)
+};
+
+struct Vertex {
+	float position[3] = {};
+	float uv[2] = {};
+};
+
+struct Shape {
+	virtual ~Shape() = default;
+
+	y_serde3_poly_base(Shape)
+};
+
+y::serde3::detail::PolyType<Shape> Shape::_y_serde3_poly_base;
+
+struct Circle : Shape {
+	float radius = 0.0f;
+
+	y_serde3(radius)
+	y_serde3_poly(Circle)
+};
+
+struct Square : Shape {
+	i32 side = 0;
+	u32 color = 0;
+
+	y_serde3(side, color)
+	y_serde3_poly(Square)
+};
+
+// Lots of registered types, so that looking them up matters
+template<usize N>
+struct Tagged : Shape {
+	u32 value = N;
+
+	y_serde3(value)
+	y_serde3_poly(Tagged)
+};
+
+static constexpr usize tagged_type_count = 64;
+
+template<usize... I>
+static std::unique_ptr<Shape> make_tagged(usize index, std::index_sequence<I...>) {
+	std::unique_ptr<Shape> shape;
+	((I == index ? void(shape = std::make_unique<Tagged<I>>()) : void()), ...);
+	return shape;
+}
+
+// Stored with u32 and float members by serde3_legacy.cpp, so every member goes through try_convert
+struct Sample {
+	u64 id = 0;
+	double value = 0.0;
+
+	y_serde3(id, value)
+};
+
+static usize node_count(const Node& node) {
+	usize count = 1;
+	for(const Node& child : node.children) {
+		count += node_count(child);
+	}
+	return count;
+}
+
+static Node make_tree(usize depth, u32& id) {
+	Node node;
+	node.id = id++;
+	node.weight = float(node.id) * 0.5f;
+	node.name = fmt("node %", node.id);
+	if(depth) {
+		for(usize i = 0; i != 4; ++i) {
+			node.children << make_tree(depth - 1, id);
+		}
+	}
+	return node;
+}
+
+static const char* file_name = "bench_serde3.bin";
+
+template<typename T>
+static void bench_round_trip(const char* name, const T& value, usize object_count) {
+	io2::Buffer buffer;
+	const auto save = [&](io2::Writer& writer) {
+		serde3::WritableArchive arc(writer);
+		if(!arc.serialize(value)) {
+			y_fatal("Serialization failed.");
+		}
+		return object_count;
+	};
+	const auto load = [&](io2::Reader& reader) {
+		T loaded;
+		serde3::ReadableArchive arc(reader);
+		if(!arc.deserialize(loaded)) {
+			y_fatal("Deserialization failed.");
+		}
+		return object_count;
+	};
+
+	save(buffer);
+	const usize bytes = buffer.size();
+
+	log_msg(fmt("%: % objects, % bytes", name, object_count, bytes), Log::Perf);
+	bench::run("save (buffer)", "objects", bytes, [&] {
+		buffer.clear();
+		return save(buffer);
+	});
+	bench::run("load (buffer)", "objects", bytes, [&] {
+		buffer.reset();
+		return load(buffer);
+	});
+	bench::run("save (file)", "objects", bytes, [&] {
+		auto file = std::move(io2::File::create(file_name).unwrap());
+		return save(file);
+	});
+	bench::run("load (file)", "objects", bytes, [&] {
+		auto file = std::move(io2::File::open(file_name).unwrap());
+		return load(file);
+	});
+	std::remove(file_name);
+}
+
+static void bench_tree() {
+	u32 id = 0;
+	const Node root = make_tree(7, id);
+	bench_round_trip("deep tree", root, node_count(root));
+}
+
+static void bench_pod_vector() {
+	core::Vector<Vertex> vertices;
+	for(usize i = 0; i != 1000000; ++i) {
+		vertices << Vertex{{float(i), 1.0f, 2.0f}, {0.5f, float(i)}};
+	}
+	bench_round_trip("POD vector", vertices, vertices.size());
+}
+
+static void bench_strings() {
+	core::Vector<core::String> strings;
+	for(usize i = 0; i != 200000; ++i) {
+		strings << fmt("string number %", i);
+	}
+	bench_round_trip("string vector", strings, strings.size());
+}
+
+static void bench_hash_map() {
+	core::ExternalHashMap<u32, core::String> map;
+	for(u32 i = 0; i != 100000; ++i) {
+		map.emplace(i * 7, fmt("value %", i));
+	}
+	bench_round_trip("hash map", map, map.size());
+}
+
+static void bench_poly() {
+	core::Vector<std::unique_ptr<Shape>> shapes;
+	for(usize i = 0; i != 100000; ++i) {
+		if(i % 2) {
+			auto circle = std::make_unique<Circle>();
+			circle->radius = float(i);
+			shapes << std::move(circle);
+		} else {
+			auto square = std::make_unique<Square>();
+			square->side = i32(i);
+			shapes << std::move(square);
+		}
+	}
+	bench_round_trip("polymorphic pointers", shapes, shapes.size());
+}
+
+static void bench_many_poly_types() {
+	core::Vector<std::unique_ptr<Shape>> shapes;
+	for(usize i = 0; i != 1000000; ++i) {
+		shapes << make_tagged(i % tagged_type_count, std::make_index_sequence<tagged_type_count>());
+	}
+	bench_round_trip("polymorphic pointers (66 types)", shapes, shapes.size());
+}
+
+static void bench_schema_change() {
+	static constexpr usize count = 200000;
+
+	io2::Buffer buffer;
+	write_legacy_samples(buffer, count);
+
+	log_msg(fmt("changed schema: % objects, % bytes", count, buffer.size()), Log::Perf);
+	bench::run("load (buffer)", "objects", buffer.size(), [&] {
+		buffer.reset();
+		core::Vector<Sample> samples;
+		serde3::ReadableArchive arc(buffer);
+		if(!arc.deserialize(samples) || samples.size() != count) {
+			y_fatal("Deserialization failed.");
+		}
+		bench::keep(samples.last().id);
+		return count;
+	});
+}
+
+}
+
+int main() {
+	log_msg("serde3:", Log::Perf);
+	bench_tree();
+	bench_pod_vector();
+	bench_strings();
+	bench_hash_map();
+	bench_poly();
+	bench_many_poly_types();
+	bench_schema_change();
+
+	return 0;
+}
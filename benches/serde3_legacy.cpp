@@ -0,0 +1,48 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include <y/serde3/archives.h>
+#include <y/io2/Buffer.h>
+
+using namespace y;
+
+namespace {
+
+// Older layout of the Sample in serde3.cpp: both live in an anonymous namespace and share the same type name
+struct Sample {
+	u32 id = 0;
+	float value = 0.0f;
+
+	y_serde3(id, value)
+};
+
+}
+
+void write_legacy_samples(io2::Buffer& buffer, usize count) {
+	core::Vector<Sample> samples;
+	for(usize i = 0; i != count; ++i) {
+		samples << Sample{u32(i), float(i) * 0.25f};
+	}
+
+	serde3::WritableArchive arc(buffer);
+	y_always_assert(arc.serialize(samples), "Unable to serialize samples");
+}
@@ -31,6 +31,7 @@ SOFTWARE.
 #include <y/math/random.h>
 
 #include <ctime>
+#include <unordered_map>
 
 namespace {
 using namespace y;
@@ -23,6 +23,8 @@ SOFTWARE.
 #include <y/mem/allocators.h>
 #include <y/core/Vector.h>
 
+#include <thread>
+
 namespace {
 using namespace y;
 using namespace memory;
@@ -71,4 +73,82 @@ y_test_func("FixedSizeFreeListAllocator basic") {
 	allocator.deallocate(p3, size - 1);
 	allocator.deallocate(p2, min_size);
 }*/
+
+y_test_func("ProfilingAllocator stats") {
+	static AllocationStats stats("test");
+	ProfilingAllocator<Mallocator> allocator(&stats);
+
+	void* a = allocator.allocate(16);
+	void* b = allocator.allocate(100);
+	allocator.deallocate(a, 16);
+	void* c = allocator.allocate(4);
+
+	{
+		const AllocationSnapshot snap = stats.snapshot();
+		y_test_assert(snap.current_bytes == 104);
+		y_test_assert(snap.peak_bytes == 116);
+		y_test_assert(snap.total_bytes == 120);
+		y_test_assert(snap.allocation_count == 3);
+		y_test_assert(snap.deallocation_count == 1);
+		y_test_assert(snap.histogram[2] == 1);
+		y_test_assert(snap.histogram[4] == 1);
+		y_test_assert(snap.histogram[6] == 1);
+	}
+
+	allocator.deallocate(b, 100);
+	allocator.deallocate(c, 4);
+
+	bool found = false;
+	for(const AllocationSnapshot& snap : AllocationStats::snapshot_all()) {
+		if(snap.tag == stats.tag()) {
+			y_test_assert(snap.current_bytes == 0);
+			found = true;
+		}
+	}
+	y_test_assert(found);
+}
+
+y_test_func("MagazineAllocator reuse") {
+	MagazineAllocator<LeakDetectorAllocator<Mallocator>> allocator;
+
+	void* a = allocator.allocate(24);
+	allocator.deallocate(a, 24);
+	void* b = allocator.allocate(20);
+	y_test_assert(a == b);
+
+	void* large = allocator.allocate(4096);
+	y_test_assert(large);
+	allocator.deallocate(large, 4096);
+	allocator.deallocate(b, 20);
+}
+
+y_test_func("MagazineAllocator threads") {
+	MagazineAllocator<LeakDetectorAllocator<Mallocator>> allocator;
+	std::atomic<usize> allocated = 0;
+
+	core::Vector<std::thread> threads;
+	for(usize t = 0; t != 4; ++t) {
+		threads.emplace_back([&allocator, &allocated, t] {
+			core::Vector<std::pair<u8*, usize>> blocks;
+			for(usize i = 0; i != 2000; ++i) {
+				const usize size = (i * 7 + t) % 600 + 1;
+				u8* ptr = static_cast<u8*>(allocator.allocate(size));
+				allocated += ptr ? 1 : 0;
+				std::fill_n(ptr, size, u8(t));
+				blocks.emplace_back(ptr, size);
+				if(i % 3 == 0) {
+					allocator.deallocate(blocks.first().first, blocks.first().second);
+					blocks.erase(blocks.begin());
+				}
+			}
+			for(const auto& [ptr, size] : blocks) {
+				allocator.deallocate(ptr, size);
+			}
+		});
+	}
+	for(auto& thread : threads) {
+		thread.join();
+	}
+	y_test_assert(allocated == 4 * 2000);
+}
 }
@@ -0,0 +1,654 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include <y/ecs/EntityWorld.h>
+#include <y/ecs/SystemScheduler.h>
+#include <y/ecs/CommandBuffer.h>
+#include <y/ecs/Query.h>
+#include <y/io2/Buffer.h>
+#include <y/utils/format.h>
+#include <y/test/test.h>
+
+#include <atomic>
+
+namespace {
+using namespace y;
+using namespace y::ecs;
+
+struct Position {
+	float x = 0.0f;
+	float y = 0.0f;
+};
+
+struct Velocity {
+	float x = 1.0f;
+	float y = 2.0f;
+};
+
+struct Health {
+	u32 value = 100;
+};
+
+struct Frozen {
+};
+
+struct alignas(256) Aligned {
+	u32 value = 7;
+};
+
+struct Name {
+	core::String name;
+
+	y_serde3(name)
+};
+
+static void fill_world(EntityWorld& world, usize count) {
+	for(usize i = 0; i != count; ++i) {
+		const EntityID id = world.create_entity();
+		world.add_components<Position, Velocity>(id);
+		if(i % 3 == 0) {
+			world.add_component<Health>(id);
+		}
+	}
+}
+
+static usize position_chunk_count(const EntityWorld& world) {
+	usize chunks = 0;
+	for(const auto& arc : world.archetypes()) {
+		chunks += arc->view<const Position>().chunk_count();
+	}
+	return chunks;
+}
+
+y_test_func("EntityWorld parallel_for_each") {
+	concurrent::StaticThreadPool pool(4);
+	EntityWorld world;
+	fill_world(world, 5000);
+
+	world.parallel_for_each<Position, const Velocity>(pool, [](Position& pos, const Velocity& vel) {
+		pos.x += vel.x;
+		pos.y += vel.y;
+	});
+
+	usize count = 0;
+	for(const auto& [pos] : world.view<const Position>()) {
+		y_test_assert(pos.x == 1.0f && pos.y == 2.0f);
+		++count;
+	}
+	y_test_assert(count == 5000);
+}
+
+y_test_func("EntityWorld parallel_for_each_chunk") {
+	concurrent::StaticThreadPool pool(4);
+	EntityWorld world;
+	fill_world(world, 5000);
+
+	std::atomic<usize> count = 0;
+	world.parallel_for_each_chunk<Health, const Position>(pool, [&](core::MutableSpan<Health> health, core::Span<Position> pos) {
+		y_test_assert(health.size() == pos.size());
+		y_test_assert(health.size() <= chunk_byte_size / sizeof(Health));
+		for(Health& h : health) {
+			--h.value;
+		}
+		count += health.size();
+	});
+	y_test_assert(count == 1667);
+
+	for(const auto& [health] : world.view<const Health>()) {
+		y_test_assert(health.value == 99);
+	}
+}
+
+y_test_func("EntityWorld chunk_view") {
+	EntityWorld world;
+	fill_world(world, 5000);
+
+	usize count = 0;
+	usize chunks = 0;
+	for(auto [size, pos, vel] : world.chunk_view<Position, const Velocity>()) {
+		y_test_assert(size == pos.size() && size == vel.size());
+		y_test_assert(usize(pos.data()) % chunk_alignment == 0);
+		y_test_assert(usize(vel.data()) % chunk_alignment == 0);
+		for(usize i = 0; i != size; ++i) {
+			pos[i].x += vel[i].x;
+		}
+		count += size;
+		++chunks;
+	}
+	y_test_assert(count == 5000);
+	y_test_assert(chunks == position_chunk_count(world));
+	y_test_assert(chunks > 2);
+
+	for(const auto& [pos] : world.view<const Position>()) {
+		y_test_assert(pos.x == 1.0f);
+	}
+}
+
+y_test_func("SystemScheduler dependencies") {
+	concurrent::StaticThreadPool pool(4);
+	EntityWorld world;
+	fill_world(world, 3000);
+
+	std::atomic<usize> health_sum = 0;
+	std::atomic<usize> pos_sum = 0;
+
+	SystemScheduler scheduler(world);
+	scheduler.add_system<Position, const Velocity>("move", [](auto view) {
+		for(auto [pos, vel] : view) {
+			pos.x += vel.x;
+		}
+	});
+	scheduler.add_system<const Health>("health", [&](auto view) {
+		for(const auto& [health] : view) {
+			health_sum += health.value;
+		}
+	});
+	scheduler.add_chunk_system<const Position>("sum", [&](auto view) {
+		for(auto [size, pos] : view) {
+			for(usize i = 0; i != size; ++i) {
+				pos_sum += usize(pos[i].x);
+			}
+		}
+	});
+	scheduler.add_system<Position>("reset", [](auto view) {
+		for(auto [pos] : view) {
+			pos.x = 0.0f;
+		}
+	});
+
+	y_test_assert(scheduler.dependencies(0).is_empty());
+	y_test_assert(scheduler.dependencies(1).is_empty());
+	y_test_assert(scheduler.dependencies(2).size() == 1 && scheduler.dependencies(2)[0] == 0);
+	y_test_assert(scheduler.dependencies(3).size() == 1 && scheduler.dependencies(3)[0] == 2);
+
+	for(usize i = 0; i != 4; ++i) {
+		scheduler.run(pool);
+	}
+
+	y_test_assert(health_sum == 4 * 1000 * 100);
+	y_test_assert(pos_sum == 4 * 3000);
+}
+
+y_test_func("EntityWorld add and remove components") {
+	EntityWorld world;
+
+	const EntityID a = world.create_entity();
+	const EntityID b = world.create_entity();
+
+	world.add_components<Position, Velocity>(a);
+	world.add_components<Velocity, Position>(b);
+	y_test_assert(world.archetypes().size() == 1);
+
+	world.component<Position>(a)->x = 4.0f;
+	world.component<Position>(b)->x = 7.0f;
+
+	world.remove_component<Velocity>(b);
+	y_test_assert(world.archetypes().size() == 2);
+	y_test_assert(!world.component<Velocity>(b));
+	y_test_assert(world.component<Position>(b)->x == 7.0f);
+
+	world.remove_component<Velocity>(a);
+	y_test_assert(world.archetypes().size() == 2);
+	y_test_assert(world.component<Position>(a)->x == 4.0f);
+
+	world.add_component<Velocity>(a);
+	y_test_assert(world.archetypes().size() == 2);
+	y_test_assert(world.component<Position>(a)->x == 4.0f);
+	y_test_assert(world.component<Velocity>(a)->y == 2.0f);
+
+	world.remove_components<Position, Velocity>(a);
+	y_test_assert(world.exists(a));
+	y_test_assert(!world.component<Position>(a));
+
+	world.add_component<Health>(a);
+	y_test_assert(world.archetypes().size() == 3);
+	y_test_assert(world.component<Health>(a)->value == 100);
+}
+
+y_test_func("CommandBuffer playback") {
+	concurrent::StaticThreadPool pool(4);
+	EntityWorld world;
+
+	CommandBuffer spawn;
+	spawn.create_entities<Position, Velocity>(3000);
+	world.apply(spawn);
+	y_test_assert(spawn.is_empty());
+
+	core::Vector<EntityID> ids;
+	for(const EntityID id : world.entity_ids()) {
+		world.component<Position>(id)->x = float(id.index());
+		ids << id;
+	}
+	y_test_assert(ids.size() == 3000);
+
+	CommandBuffer buffer;
+	world.parallel_for_each<const Position>(pool, [&](const Position& pos) {
+		const EntityID id(u32(pos.x));
+		switch(id.index() % 4) {
+			case 0:
+				buffer.remove_entity(id);
+			break;
+			case 1:
+				buffer.add_component<Health>(id);
+			break;
+			case 2:
+				buffer.remove_component<Velocity>(id);
+			break;
+			default:
+				buffer.add_component<Health>(id);
+				buffer.remove_component<Health>(id);
+			break;
+		}
+	});
+	world.apply(buffer);
+
+	for(const EntityID id : ids) {
+		const usize kind = id.index() % 4;
+		if(kind == 0) {
+			y_test_assert(!world.component<Position>(id));
+			continue;
+		}
+		y_test_assert(world.component<Position>(id)->x == float(id.index()));
+		y_test_assert(!world.component<Health>(id) == (kind != 1));
+		y_test_assert(!world.component<Velocity>(id) == (kind == 2));
+	}
+}
+
+y_test_func("EntityWorld id recycling") {
+	EntityWorld world;
+
+	const EntityID a = world.create_entity();
+	const EntityID b = world.create_entity();
+	world.add_component<Position>(a);
+	world.add_component<Position>(b);
+	world.component<Position>(b)->x = 3.0f;
+
+	world.remove_entity(a);
+	y_test_assert(!world.exists(a));
+	y_test_assert(world.component<Position>(b)->x == 3.0f);
+
+	const EntityID c = world.create_entity();
+	y_test_assert(c.index() == a.index() && c.version() != a.version());
+	y_test_assert(world.exists(c) && !world.exists(a));
+	y_test_assert(!world.component<Position>(c));
+
+	for(usize i = 0; i != 1000; ++i) {
+		const EntityID id = world.create_entity();
+		world.add_component<Velocity>(id);
+		world.remove_entity(id);
+	}
+	const EntityID d = world.create_entity();
+	y_test_assert(d.index() < 3);
+
+	y_test_assert(world.entity_ids().size() == 3);
+	for(const EntityID id : world.entity_ids()) {
+		y_test_assert(world.exists(id));
+	}
+}
+
+y_test_func("EntityWorld change versions") {
+	EntityWorld world;
+	fill_world(world, 5000);
+
+	const auto count_chunks = [&](u64 since) {
+		usize chunks = 0;
+		for(auto&& chunk : world.changed_chunk_view<const Position>(since)) {
+			unused(chunk);
+			++chunks;
+		}
+		return chunks;
+	};
+
+	const usize chunk_count = position_chunk_count(world);
+	y_test_assert(count_chunks(0) == chunk_count);
+
+	const u64 tick = world.advance_tick();
+	y_test_assert(count_chunks(tick) == 0);
+
+	for(const auto& [pos] : world.view<const Position>()) {
+		unused(pos);
+	}
+	const EntityID id = world.entity_ids()[42];
+	y_test_assert(std::as_const(world).component<Position>(id));
+	y_test_assert(count_chunks(tick) == 0);
+
+	world.component<Position>(id)->x = 5.0f;
+	y_test_assert(count_chunks(tick) == 1);
+
+	world.add_component<Health>(world.entity_ids()[43]);
+	y_test_assert(count_chunks(tick) == 3);
+
+	usize visited = 0;
+	SystemScheduler scheduler(world);
+	scheduler.add_changed_chunk_system<const Position>("changed", [&](auto view) {
+		for(auto&& chunk : view) {
+			unused(chunk);
+			++visited;
+		}
+	});
+	scheduler.run_sequential();
+	y_test_assert(visited == chunk_count);
+
+	// Chunks written during the tick of the previous run are visited again
+	scheduler.run_sequential();
+	y_test_assert(visited == chunk_count + 3);
+	scheduler.run_sequential();
+	y_test_assert(visited == chunk_count + 3);
+}
+
+y_test_func("Query incremental matching") {
+	EntityWorld world;
+	fill_world(world, 3000);
+
+	Query<Position, const Health> query;
+	query.update(world);
+	y_test_assert(query.matches().size() == 1);
+
+	usize count = 0;
+	for(auto [pos, health] : query.view(world)) {
+		pos.x = float(health.value);
+		++count;
+	}
+	y_test_assert(count == 1000);
+
+	const EntityID id = world.create_entity();
+	world.add_components<Health, Position>(id);
+	query.update(world);
+	y_test_assert(query.matches().size() == 2);
+
+	count = 0;
+	for(auto [size, pos, health] : query.chunk_view(world)) {
+		count += size;
+	}
+	y_test_assert(count == 1001);
+}
+
+y_test_func("EntityWorld over aligned components") {
+	EntityWorld world;
+	fill_world(world, 3000);
+	for(const EntityID id : world.entity_ids()) {
+		if(id.index() % 2) {
+			world.add_component<Aligned>(id);
+		}
+	}
+
+	usize count = 0;
+	for(auto [size, aligned, pos] : world.chunk_view<const Aligned, const Position>()) {
+		y_test_assert(usize(aligned.data()) % alignof(Aligned) == 0);
+		y_test_assert(usize(pos.data()) % chunk_alignment == 0);
+		for(usize i = 0; i != size; ++i) {
+			y_test_assert(aligned[i].value == 7);
+		}
+		count += size;
+	}
+	y_test_assert(count == 1500);
+}
+
+y_test_func("EntityWorld chunk pool") {
+	EntityWorld world;
+	fill_world(world, 5000);
+
+	for(const auto& arc : world.archetypes()) {
+		y_test_assert(arc->entities_per_chunk() > 1);
+		y_test_assert(arc->entities_per_chunk() * (sizeof(EntityID) + sizeof(Position) + sizeof(Velocity)) <= chunk_byte_size);
+	}
+	y_test_assert(world.chunk_pool().free_chunk_count() == 0);
+
+	const usize chunks = position_chunk_count(world);
+	const core::Vector<EntityID> ids(world.entity_ids());
+	for(const EntityID id : ids) {
+		world.remove_entity(id);
+	}
+	y_test_assert(world.chunk_pool().free_chunk_count() == chunks);
+
+	fill_world(world, 5000);
+	y_test_assert(world.chunk_pool().free_chunk_count() == 0);
+	y_test_assert(position_chunk_count(world) == chunks);
+}
+
+y_test_func("EntityWorld chunk pool with over aligned components") {
+	EntityWorld world;
+	for(usize i = 0; i != 1000; ++i) {
+		world.add_components<Position, Aligned>(world.create_entity());
+	}
+
+	for(const auto& arc : world.archetypes()) {
+		y_test_assert(arc->entities_per_chunk() > 1);
+		y_test_assert(arc->entities_per_chunk() * (sizeof(EntityID) + sizeof(Position) + sizeof(Aligned)) <= chunk_byte_size);
+	}
+
+	// Over aligned chunks are given back to the allocator instead of being pooled
+	const usize free_chunks = world.chunk_pool().free_chunk_count();
+	const core::Vector<EntityID> ids(world.entity_ids());
+	for(const EntityID id : ids) {
+		world.remove_entity(id);
+	}
+	y_test_assert(world.chunk_pool().free_chunk_count() == free_chunks);
+
+	for(usize i = 0; i != 1000; ++i) {
+		world.add_components<Position, Aligned>(world.create_entity());
+	}
+	for(auto [size, aligned, pos] : world.chunk_view<const Aligned, const Position>()) {
+		y_test_assert(usize(aligned.data()) % alignof(Aligned) == 0);
+		y_test_assert(usize(pos.data()) % chunk_alignment == 0);
+	}
+}
+
+y_test_func("EntityWorld snapshot") {
+	EntityWorld world;
+	fill_world(world, 5000);
+	for(const EntityID id : world.entity_ids()) {
+		world.component<Position>(id)->x = float(id.index());
+		if(id.index() % 7 == 0) {
+			world.add_component<Name>(id);
+			world.component<Name>(id)->name = fmt("entity %", id.index());
+		}
+	}
+	world.remove_entity(world.entity_ids()[17]);
+
+	io2::Buffer buffer;
+	y_test_assert(world.save(buffer));
+	buffer.reset();
+
+	EntityWorld loaded;
+	y_test_assert(loaded.load(buffer));
+	y_test_assert(buffer.at_end());
+
+	y_test_assert(loaded.entity_ids().size() == world.entity_ids().size());
+	for(const EntityID id : world.entity_ids()) {
+		y_test_assert(loaded.exists(id));
+		y_test_assert(loaded.component<Position>(id)->x == float(id.index()));
+		y_test_assert(loaded.component<Velocity>(id)->y == 2.0f);
+		y_test_assert(!loaded.component<Health>(id) == !world.component<Health>(id));
+		if(const Name* name = world.component<Name>(id)) {
+			y_test_assert(loaded.component<Name>(id)->name == name->name);
+		} else {
+			y_test_assert(!loaded.component<Name>(id));
+		}
+	}
+
+	const EntityID recycled = loaded.create_entity();
+	y_test_assert(recycled.index() == 17 && !world.exists(recycled));
+}
+
+y_test_func("EntityWorld corrupted snapshot") {
+	EntityWorld world;
+	fill_world(world, 10);
+
+	io2::Buffer buffer;
+	y_test_assert(world.save(buffer));
+	core::Vector<u8> data(buffer.size(), 0);
+	std::memcpy(data.data(), buffer.data(), buffer.size());
+
+	// Truncated snapshots fail instead of reading past the end
+	for(const usize size : {usize(4), usize(16), data.size() / 2, data.size() - 1}) {
+		io2::Buffer truncated;
+		y_test_assert(truncated.write(data.data(), size));
+		truncated.reset();
+		EntityWorld loaded;
+		y_test_assert(loaded.load(truncated).is_error());
+	}
+
+	// Huge counts fail before anything is allocated
+	for(usize offset = 8; offset + sizeof(u64) <= data.size(); ++offset) {
+		core::Vector<u8> corrupted = data;
+		const u64 huge = u64(1) << 60;
+		std::memcpy(corrupted.data() + offset, &huge, sizeof(huge));
+
+		io2::Buffer buffer;
+		y_test_assert(buffer.write(corrupted.data(), corrupted.size()));
+		buffer.reset();
+		EntityWorld loaded;
+		unused(loaded.load(buffer));
+	}
+}
+
+y_test_func("EntityWorld tags and shared components") {
+	EntityWorld world;
+	fill_world(world, 3000);
+	const usize per_chunk = world.archetypes()[0]->entities_per_chunk();
+
+	for(const EntityID id : world.entity_ids()) {
+		if(id.index() % 2 == 0) {
+			world.add_component<Frozen>(id);
+		}
+		if(world.component<Health>(id)) {
+			world.add_component<Shared<Health>>(id);
+		}
+	}
+
+	usize frozen = 0;
+	for(const auto& arc : world.archetypes()) {
+		if(arc->entity_count() && !arc->view<const Health>().size()) {
+			y_test_assert(arc->entities_per_chunk() == per_chunk);
+		}
+		frozen += arc->view<const Position, const Frozen>().size();
+	}
+	y_test_assert(frozen == 1500);
+
+	const EntityID a = world.entity_ids()[0];
+	const EntityID b = world.entity_ids()[6];
+	y_test_assert(world.component<Shared<Health>>(a) == world.component<Shared<Health>>(b));
+	world.component<Shared<Health>>(a)->value.value = 7;
+
+	usize shared = 0;
+	for(auto [health, pos] : world.view<const Shared<Health>, Position>()) {
+		shared += health.value.value == 7;
+		pos.x = 1.0f;
+	}
+	y_test_assert(shared == 500);
+
+	io2::Buffer buffer;
+	y_test_assert(world.save(buffer));
+	buffer.reset();
+
+	EntityWorld loaded;
+	y_test_assert(loaded.load(buffer));
+	y_test_assert(loaded.component<Shared<Health>>(b)->value.value == 7);
+	y_test_assert(loaded.component<Frozen>(b) && !loaded.component<Frozen>(loaded.entity_ids()[1]));
+}
+
+y_test_func("EntityWorld sort entities") {
+	EntityWorld world;
+	fill_world(world, 3000);
+	for(const EntityID id : world.entity_ids()) {
+		world.component<Position>(id)->x = float((id.index() * 7919) % 1000);
+		world.component<Velocity>(id)->x = float(id.index());
+	}
+
+	usize passes = 1;
+	usize key_reads = 0;
+	const auto key = [&](const Position& pos) { ++key_reads; return pos.x; };
+	while(!world.sort_entities<Position>(key, 100)) {
+		world.advance_tick();
+		++passes;
+	}
+	y_test_assert(passes > 10);
+	y_test_assert(key_reads <= 3000 * 2);
+
+	world.advance_tick();
+	y_test_assert(world.sort_entities<Position>(key, 0));
+	world.advance_tick();
+	key_reads = 0;
+	y_test_assert(world.sort_entities<Position>(key, 0));
+	y_test_assert(!key_reads);
+
+	for(const auto& arc : world.archetypes()) {
+		float last = 0.0f;
+		for(const auto& [pos] : arc->view<const Position>()) {
+			y_test_assert(pos.x >= last);
+			last = pos.x;
+		}
+	}
+	for(const EntityID id : world.entity_ids()) {
+		y_test_assert(world.component<Velocity>(id)->x == float(id.index()));
+		y_test_assert(world.component<Position>(id)->x == float((id.index() * 7919) % 1000));
+	}
+}
+
+y_test_func("EntityWorld sort entities exact budget") {
+	EntityWorld world;
+	fill_world(world, 3);
+	const EntityID ids[] = {world.entity_ids()[1], world.entity_ids()[2]};
+	world.component<Position>(ids[0])->x = 2.0f;
+	world.component<Position>(ids[1])->x = 1.0f;
+
+	const auto key = [](const Position& pos) { return pos.x; };
+	y_test_assert(!world.sort_entities<Position>(key, 0));
+	y_test_assert(world.sort_entities<Position>(key, 1));
+	y_test_assert(world.component<Position>(ids[0])->x == 2.0f);
+
+	world.advance_tick();
+	world.component<Position>(ids[0])->x = 0.0f;
+	y_test_assert(!world.sort_entities<Position>(key, 0));
+	y_test_assert(world.sort_entities<Position>(key));
+}
+
+y_test_func("EntityWorld sort entities skips unchanged archetypes") {
+	EntityWorld world;
+	fill_world(world, 3000);
+	for(const EntityID id : world.entity_ids()) {
+		world.component<Position>(id)->x = float((id.index() * 7919) % 1000);
+	}
+
+	usize key_reads = 0;
+	const auto key = [&](const Position& pos) { ++key_reads; return pos.x; };
+	y_test_assert(world.sort_entities<Position>(key));
+	y_test_assert(key_reads == 3000);
+
+	// Rows moved by the sort don't need to be checked again, even in the same tick
+	key_reads = 0;
+	y_test_assert(world.sort_entities<Position>(key));
+	y_test_assert(!key_reads);
+
+	// Only the written archetype is sorted again
+	world.advance_tick();
+	Archetype* written = world.archetypes()[0].get();
+	for(const auto& [pos] : written->view<Position>()) {
+		pos.x = 1000.0f - pos.x;
+	}
+	y_test_assert(world.sort_entities<Position>(key));
+	y_test_assert(key_reads && key_reads == written->entity_count());
+	y_test_assert(world.sort_entities<Position>(key));
+	y_test_assert(key_reads == written->entity_count());
+}
+}
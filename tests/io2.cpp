@@ -0,0 +1,193 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include <y/io2/Buffer.h>
+#include <y/io2/Compressed.h>
+#include <y/io2/lz.h>
+#include <y/concurrent/StaticThreadPool.h>
+#include <y/serde3/archives.h>
+#include <y/math/random.h>
+#include <y/test/test.h>
+
+#include <cstring>
+#include <memory>
+
+namespace {
+using namespace y;
+
+// Text like data with a lot of repetitions, and a few random bytes
+static core::Vector<u8> make_data(usize size, u32 seed = 1) {
+	math::FastRandom rnd(seed);
+	core::Vector<u8> data;
+	data.set_min_capacity(size);
+	const char* words[] = {"entity ", "component ", "archetype ", "chunk ", "serde3 ", "io2 "};
+	while(data.size() < size) {
+		if(rnd() % 16) {
+			const char* word = words[rnd() % 6];
+			for(usize i = 0; word[i] && data.size() < size; ++i) {
+				data << u8(word[i]);
+			}
+		} else {
+			data << u8(rnd());
+		}
+	}
+	return data;
+}
+
+static bool lz_round_trip(const core::Vector<u8>& data) {
+	auto compressed = std::make_unique<u8[]>(io2::lz::compress_bound(data.size()));
+	const usize size = io2::lz::compress(data.data(), data.size(), compressed.get());
+
+	auto decompressed = std::make_unique<u8[]>(data.size() + 1);
+	return io2::lz::decompress(compressed.get(), size, decompressed.get(), data.size()) &&
+		   !io2::lz::decompress(compressed.get(), size, decompressed.get(), data.size() + 1) &&
+		   std::equal(data.begin(), data.end(), decompressed.get());
+}
+
+y_test_func("lz round trip") {
+	for(usize size = 0; size != 64; ++size) {
+		y_test_assert(lz_round_trip(make_data(size, u32(size))));
+	}
+
+	y_test_assert(lz_round_trip(make_data(1024 * 1024)));
+
+	core::Vector<u8> noise;
+	math::FastRandom rnd;
+	for(usize i = 0; i != 100000; ++i) {
+		noise << u8(rnd());
+	}
+	y_test_assert(lz_round_trip(noise));
+
+	// Overlapping matches
+	core::Vector<u8> runs;
+	for(usize i = 0; i != 100000; ++i) {
+		runs << u8(i / 1000);
+	}
+	y_test_assert(lz_round_trip(runs));
+
+	const core::Vector<u8> data = make_data(100000);
+	auto compressed = std::make_unique<u8[]>(io2::lz::compress_bound(data.size()));
+	y_test_assert(io2::lz::compress(data.data(), data.size(), compressed.get()) * 2 < data.size());
+}
+
+y_test_func("Compressed stream") {
+	const core::Vector<u8> data = make_data(3 * 1024 * 1024 + 17);
+	concurrent::StaticThreadPool pool(4);
+
+	for(concurrent::StaticThreadPool* writer_pool : {static_cast<concurrent::StaticThreadPool*>(nullptr), &pool}) {
+		io2::Buffer buffer;
+		{
+			io2::CompressedWriter writer(buffer, 64 * 1024, writer_pool);
+			for(usize i = 0; i < data.size(); i += 1000) {
+				y_test_assert(writer.write(data.data() + i, std::min(usize(1000), data.size() - i)));
+			}
+			y_test_assert(writer.tell() == data.size());
+			y_test_assert(writer.finish());
+		}
+		y_test_assert(buffer.size() * 2 < data.size());
+		buffer.reset();
+
+		auto reader = std::move(io2::CompressedReader::open(buffer).unwrap());
+		y_test_assert(reader.size() == data.size());
+
+		core::Vector<u8> loaded;
+		y_test_assert(reader.read_all(loaded));
+		y_test_assert(reader.at_end());
+		y_test_assert(loaded.size() == data.size());
+		y_test_assert(std::equal(data.begin(), data.end(), loaded.begin()));
+
+		// Reads across blocks at random positions
+		math::FastRandom rnd;
+		u8 bytes[100000];
+		for(usize i = 0; i != 64; ++i) {
+			const usize pos = rnd() % data.size();
+			const usize count = std::min(usize(rnd() % sizeof(bytes)), data.size() - pos);
+			reader.seek(pos);
+			y_test_assert(reader.read(bytes, count));
+			y_test_assert(reader.tell() == pos + count);
+			y_test_assert(std::equal(bytes, bytes + count, data.begin() + pos));
+		}
+	}
+}
+
+y_test_func("Compressed stream corruption") {
+	io2::Buffer buffer;
+	{
+		const core::Vector<u8> data = make_data(200 * 1024);
+		io2::CompressedWriter writer(buffer);
+		y_test_assert(writer.write(data.data(), data.size()));
+	}
+
+	// Raw size of the first block in the index, there is no checksum so corrupted literals would go unnoticed
+	u64 index_offset = 0;
+	std::memcpy(&index_offset, buffer.data() + buffer.size() - 16, sizeof(index_offset));
+
+	io2::Buffer corrupted;
+	y_test_assert(corrupted.write(buffer.data(), buffer.size()));
+	corrupted.seek(usize(index_offset) + 4);
+	y_test_assert(corrupted.write_one(u32(1000)));
+	corrupted.reset();
+
+	auto reader = std::move(io2::CompressedReader::open(corrupted).unwrap());
+	core::Vector<u8> loaded;
+	y_test_assert(!reader.read_all(loaded));
+
+	// Truncated streams have no index
+	io2::Buffer truncated;
+	y_test_assert(truncated.write(buffer.data(), buffer.size() - 1));
+	truncated.reset();
+	y_test_assert(!io2::CompressedReader::open(truncated));
+}
+
+struct Record {
+	u32 id = 0;
+	core::Vector<u8> payload;
+
+	y_serde3(id, payload)
+};
+
+y_test_func("Compressed serde3 archive") {
+	core::Vector<Record> records;
+	for(usize i = 0; i != 5000; ++i) {
+		records << Record{u32(i), make_data(i % 100, u32(i))};
+	}
+
+	io2::Buffer buffer;
+	{
+		io2::CompressedWriter writer(buffer);
+		serde3::WritableArchive arc(writer, serde3::WriteMode::Stream);
+		y_test_assert(arc.serialize(records));
+	}
+	buffer.reset();
+
+	auto reader = std::move(io2::CompressedReader::open(buffer).unwrap());
+	core::Vector<Record> loaded;
+	serde3::ReadableArchive arc(reader);
+	y_test_assert(arc.deserialize(loaded).unwrap() == serde3::Success::Full);
+	y_test_assert(reader.at_end());
+	y_test_assert(loaded.size() == records.size());
+	for(usize i = 0; i != records.size(); ++i) {
+		y_test_assert(loaded[i].id == records[i].id && loaded[i].payload == records[i].payload);
+	}
+}
+
+}
@@ -0,0 +1,660 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include <y/serde3/archives.h>
+#include <y/core/String.h>
+#include <y/io2/Buffer.h>
+#include <y/io2/File.h>
+#include <y/io2/MappedFile.h>
+#include <y/concurrent/StaticThreadPool.h>
+#include <y/utils/format.h>
+#include <y/test/test.h>
+
+#include <cstdio>
+
+namespace y {
+void write_legacy_particles(io2::Buffer& buffer, usize count, serde3::Encoding encoding);
+}
+
+namespace {
+using namespace y;
+
+struct Item {
+	u32 id = 0;
+	core::String name;
+	core::Vector<float> values;
+
+	bool operator==(const Item& other) const {
+		return id == other.id && name == other.name && values == other.values;
+	}
+
+	y_serde3(id, name, values)
+};
+
+// Reordered members, flags was removed and drag added since serde3_legacy.cpp
+struct Particle {
+	float x = 0.0f;
+	u32 id = 0;
+	float mass = 0.0f;
+	float drag = 1.0f;
+
+	y_serde3(x, id, mass, drag)
+};
+
+struct ItemPair {
+	Item first;
+	Item second;
+
+	y_serde3(first, second)
+};
+
+struct World {
+	core::String name;
+	core::Vector<Item> items;
+	serde3::Lazy<core::Vector<Item>> cold;
+
+	y_serde3(name, items, cold)
+};
+
+struct Shape {
+	virtual ~Shape() = default;
+
+	y_serde3_poly_base(Shape)
+};
+
+y::serde3::detail::PolyType<Shape> Shape::_y_serde3_poly_base;
+
+struct Circle : Shape {
+	float radius = 0.0f;
+
+	y_serde3(radius)
+	y_serde3_poly(Circle)
+};
+
+struct Square : Shape {
+	i32 side = 0;
+
+	y_serde3(side)
+	y_serde3_poly(Square)
+};
+
+// Refuses to be serialized
+struct BrokenShape : Shape {
+	serde3::TypeId _y_serde3_poly_type_id() const override {
+		return serde3::detail::poly_type_id<BrokenShape>();
+	}
+
+	serde3::Result _y_serde3_poly_serialize(serde3::WritableArchive&) const override {
+		return core::Err();
+	}
+
+	serde3::Result _y_serde3_poly_deserialize(serde3::ReadableArchive&) override {
+		return core::Err();
+	}
+};
+
+struct Sample {
+	core::Vector<float> values;
+
+	y_serde3(values)
+};
+
+struct LazySample {
+	serde3::Lazy<Sample> sample;
+
+	y_serde3(sample)
+};
+
+// Values that keep a reference to the reader, hidden behind a poly pointer
+struct Source {
+	virtual ~Source() = default;
+
+	y_serde3_poly_base(Source)
+};
+
+y::serde3::detail::PolyType<Source> Source::_y_serde3_poly_base;
+
+struct LazySource : Source {
+	serde3::Lazy<Sample> sample;
+
+	y_serde3(sample)
+	y_serde3_poly(LazySource)
+};
+
+struct MappedSource : Source {
+	core::Span<float> values;
+
+	y_serde3(values)
+	y_serde3_poly(MappedSource)
+};
+
+static core::Vector<std::unique_ptr<Shape>> make_shapes(usize count) {
+	core::Vector<std::unique_ptr<Shape>> shapes;
+	for(usize i = 0; i != count; ++i) {
+		if(i % 2) {
+			auto circle = std::make_unique<Circle>();
+			circle->radius = float(i);
+			shapes << std::move(circle);
+		} else {
+			auto square = std::make_unique<Square>();
+			square->side = -i32(i);
+			shapes << std::move(square);
+		}
+	}
+	return shapes;
+}
+
+static bool same_shapes(const core::Vector<std::unique_ptr<Shape>>& a, const core::Vector<std::unique_ptr<Shape>>& b) {
+	if(a.size() != b.size()) {
+		return false;
+	}
+	for(usize i = 0; i != a.size(); ++i) {
+		const auto* ca = dynamic_cast<const Circle*>(a[i].get());
+		const auto* cb = dynamic_cast<const Circle*>(b[i].get());
+		const auto* sa = dynamic_cast<const Square*>(a[i].get());
+		const auto* sb = dynamic_cast<const Square*>(b[i].get());
+		if(ca ? (!cb || ca->radius != cb->radius) : (!sa || !sb || sa->side != sb->side)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Returns the serialized size, or 0 on failure
+template<typename T>
+static usize round_trip(const T& value, T& loaded, serde3::Encoding encoding) {
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer, serde3::WriteMode::Patch, encoding);
+		if(!arc.serialize(value)) {
+			return 0;
+		}
+	}
+	buffer.reset();
+
+	serde3::ReadableArchive arc(buffer, encoding);
+	const serde3::Result result = arc.deserialize(loaded);
+	if(!result || result.unwrap() != serde3::Success::Full || !buffer.at_end()) {
+		return 0;
+	}
+	return buffer.size();
+}
+
+// Fails on any seek, like a pipe or a socket
+class AppendOnlyWriter : public io2::Writer {
+	public:
+		void seek(usize) override {
+			y_fatal("Seek in append only writer.");
+		}
+
+		usize tell() const override {
+			y_fatal("Tell in append only writer.");
+		}
+
+		io2::FlushResult flush() override {
+			return core::Ok();
+		}
+
+		io2::WriteResult write(const void* data, usize bytes) override {
+			return _buffer.write(data, bytes);
+		}
+
+		io2::Buffer _buffer;
+};
+
+static core::Vector<Item> make_items(usize count) {
+	core::Vector<Item> items;
+	for(usize i = 0; i != count; ++i) {
+		Item item{u32(i), fmt("item %", i), {}};
+		for(usize k = 0; k != i % 7; ++k) {
+			item.values << float(i * k);
+		}
+		items << std::move(item);
+	}
+	return items;
+}
+
+y_test_func("serde3 round trip") {
+	const core::Vector<Item> items = make_items(20000);
+
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		y_test_assert(arc.serialize(items));
+	}
+	y_test_assert(buffer.size() > 64 * 1024);
+	buffer.reset();
+
+	core::Vector<Item> loaded;
+	serde3::ReadableArchive arc(buffer);
+	y_test_assert(arc.deserialize(loaded).unwrap() == serde3::Success::Full);
+	y_test_assert(buffer.at_end());
+	y_test_assert(loaded == items);
+}
+
+y_test_func("serde3 interleaved reads") {
+	const core::Vector<Item> items = make_items(16);
+
+	io2::Buffer buffer;
+	for(const Item& item : items) {
+		y_test_assert(buffer.write_one(item.id * 3));
+		serde3::WritableArchive arc(buffer);
+		y_test_assert(arc.serialize(item));
+	}
+	buffer.reset();
+
+	// The archive must not consume bytes past the objects it reads
+	serde3::ReadableArchive arc(buffer);
+	for(const Item& item : items) {
+		u32 raw = 0;
+		y_test_assert(buffer.read_one(raw));
+		y_test_assert(raw == item.id * 3);
+
+		Item loaded;
+		y_test_assert(arc.deserialize(loaded));
+		y_test_assert(loaded == item);
+	}
+	y_test_assert(buffer.at_end());
+}
+
+// Only spans of raw items share the header of vectors
+static_assert(std::is_same_v<serde3::deconst_t<core::Span<float>>, core::Vector<float>>);
+static_assert(std::is_same_v<serde3::deconst_t<core::Span<Item>>, core::Span<Item>>);
+static_assert(std::is_same_v<serde3::deconst_t<core::Span<Particle>>, core::Span<Particle>>);
+
+y_test_func("serde3 mapped spans") {
+	core::Vector<float> values;
+	for(usize i = 0; i != 100000; ++i) {
+		values << float(i);
+	}
+
+	const core::String file_name = "serde3_mapped_test.bin";
+	{
+		auto file = io2::File::create(file_name);
+		y_test_assert(file);
+		serde3::WritableArchive arc(file.unwrap());
+		y_test_assert(arc.serialize(values));
+	}
+
+	{
+		auto file = io2::MappedFile::open(file_name);
+		y_test_assert(file);
+		io2::MappedFile& mapped = file.unwrap();
+
+		core::Span<float> view;
+		serde3::ReadableArchive arc(mapped);
+		y_test_assert(arc.deserialize(view).unwrap() == serde3::Success::Full);
+		y_test_assert(mapped.at_end());
+
+		const u8* data = mapped.mapped_data();
+		y_test_assert(reinterpret_cast<const u8*>(view.data()) > data && reinterpret_cast<const u8*>(view.end()) <= data + mapped.size());
+		y_test_assert(std::equal(view.begin(), view.end(), values.begin(), values.end()));
+	}
+	std::remove(file_name.data());
+
+	// Spans are written like vectors
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		y_test_assert(arc.serialize(core::Span<float>(values)));
+	}
+	buffer.reset();
+
+	core::Vector<float> loaded;
+	serde3::ReadableArchive arc(buffer);
+	y_test_assert(arc.deserialize(loaded).unwrap() == serde3::Success::Full);
+	y_test_assert(loaded == values);
+}
+
+y_test_func("serde3 stream mode") {
+	const core::Vector<Item> items = make_items(10000);
+
+	io2::Buffer patched;
+	{
+		serde3::WritableArchive arc(patched);
+		y_test_assert(arc.serialize(items));
+	}
+
+	AppendOnlyWriter streamed;
+	{
+		serde3::WritableArchive arc(streamed, serde3::WriteMode::Stream);
+		y_test_assert(arc.serialize(items));
+	}
+
+	y_test_assert(patched.size() == streamed._buffer.size());
+	y_test_assert(std::equal(patched.data(), patched.data() + patched.size(), streamed._buffer.data()));
+}
+
+y_test_func("serde3 polymorphic objects") {
+	const auto shapes = make_shapes(100);
+	for(const serde3::Encoding encoding : {serde3::Encoding::Fixed, serde3::Encoding::Compact}) {
+		core::Vector<std::unique_ptr<Shape>> loaded;
+		y_test_assert(round_trip(shapes, loaded, encoding));
+		y_test_assert(same_shapes(shapes, loaded));
+	}
+}
+
+y_test_func("serde3 compact encoding") {
+	const core::Vector<Item> items = make_items(1000);
+
+	core::Vector<Item> fixed;
+	core::Vector<Item> compact;
+	const usize fixed_size = round_trip(items, fixed, serde3::Encoding::Fixed);
+	const usize compact_size = round_trip(items, compact, serde3::Encoding::Compact);
+	y_test_assert(fixed_size && compact_size);
+	y_test_assert(fixed == items);
+	y_test_assert(compact == items);
+	y_test_assert(compact_size * 3 < fixed_size);
+
+	// Packed integers can still be converted
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer, serde3::WriteMode::Patch, serde3::Encoding::Compact);
+		y_test_assert(arc.serialize(u32(300)));
+		y_test_assert(arc.serialize(i16(-5)));
+	}
+	buffer.reset();
+
+	u64 a = 0;
+	i64 b = 0;
+	serde3::ReadableArchive arc(buffer, serde3::Encoding::Compact);
+	y_test_assert(arc.deserialize(a).unwrap() == serde3::Success::Full);
+	y_test_assert(arc.deserialize(b).unwrap() == serde3::Success::Full);
+	y_test_assert(a == 300 && b == -5);
+}
+
+y_test_func("serde3 exact objects under different names") {
+	const core::Vector<Item> items = make_items(200);
+	core::Vector<ItemPair> pairs;
+	for(usize i = 0; i + 1 < items.size(); i += 2) {
+		pairs << ItemPair{items[i], items[i + 1]};
+	}
+
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		y_test_assert(arc.serialize(pairs));
+	}
+	buffer.reset();
+
+	core::Vector<ItemPair> loaded;
+	serde3::ReadableArchive arc(buffer);
+	y_test_assert(arc.deserialize(loaded).unwrap() == serde3::Success::Full);
+	y_test_assert(loaded.size() == pairs.size());
+	y_test_assert(loaded.last().second == pairs.last().second);
+
+	// Both the pairs and the items under "first" and "second" are read without a member plan
+	y_test_assert(arc.stats().exact_objects == pairs.size() * 3);
+	y_test_assert(arc.stats().planned_objects == 0);
+}
+
+y_test_func("serde3 changed member layout") {
+	for(const serde3::Encoding encoding : {serde3::Encoding::Fixed, serde3::Encoding::Compact}) {
+		io2::Buffer buffer;
+		write_legacy_particles(buffer, 5000, encoding);
+		buffer.reset();
+
+		core::Vector<Particle> particles;
+		serde3::ReadableArchive arc(buffer, encoding);
+		y_test_assert(arc.deserialize(particles));
+		y_test_assert(arc.stats().planned_objects == 5000);
+		y_test_assert(buffer.at_end());
+		y_test_assert(particles.size() == 5000);
+		for(usize i = 0; i != particles.size(); ++i) {
+			const Particle& p = particles[i];
+			y_test_assert(p.id == i && p.mass == float(i) * 0.5f && p.x == -float(i) && p.drag == 1.0f);
+		}
+	}
+}
+
+y_test_func("serde3 segmented collections") {
+	concurrent::StaticThreadPool pool(4);
+
+	const core::Vector<Item> items = make_items(10000);
+	const auto shapes = make_shapes(3000);
+
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		arc.set_thread_pool(&pool, 512);
+		y_test_assert(arc.serialize(items));
+		y_test_assert(arc.serialize(shapes));
+	}
+
+	{
+		// Segments add a table in front of the items
+		io2::Buffer sequential;
+		serde3::WritableArchive arc(sequential);
+		y_test_assert(arc.serialize(items));
+		y_test_assert(arc.serialize(shapes));
+		y_test_assert(sequential.size() < buffer.size());
+	}
+
+	// Segments can be read with or without a pool
+	for(concurrent::StaticThreadPool* reader_pool : {&pool, static_cast<concurrent::StaticThreadPool*>(nullptr)}) {
+		buffer.reset();
+
+		core::Vector<Item> loaded_items;
+		core::Vector<std::unique_ptr<Shape>> loaded_shapes;
+		serde3::ReadableArchive arc(buffer);
+		arc.set_thread_pool(reader_pool);
+		y_test_assert(arc.deserialize(loaded_items).unwrap() == serde3::Success::Full);
+		y_test_assert(arc.deserialize(loaded_shapes).unwrap() == serde3::Success::Full);
+		y_test_assert(buffer.at_end());
+		y_test_assert(loaded_items == items);
+		y_test_assert(same_shapes(shapes, loaded_shapes));
+		y_test_assert(arc.stats().pooled_segments == (reader_pool ? 20 + 6 : 0));
+	}
+}
+
+y_test_func("serde3 segmented collections and borrowed values") {
+	concurrent::StaticThreadPool pool(4);
+
+	core::Vector<float> values;
+	for(usize i = 0; i != 16; ++i) {
+		values << float(i);
+	}
+
+	// Items holding lazy values are never segmented
+	static_assert(!serde3::detail::use_collection_segments<core::Vector<LazySample>>);
+	static_assert(serde3::detail::use_collection_segments<core::Vector<Sample>>);
+
+	core::Vector<LazySample> lazy_samples;
+	core::Vector<std::unique_ptr<Source>> lazy_sources;
+	core::Vector<std::unique_ptr<Source>> mapped_sources;
+	for(usize i = 0; i != 2000; ++i) {
+		lazy_samples.emplace_back().sample = Sample{values};
+		auto lazy = std::make_unique<LazySource>();
+		lazy->sample = Sample{values};
+		lazy_sources << std::move(lazy);
+		auto mapped = std::make_unique<MappedSource>();
+		mapped->values = values;
+		mapped_sources << std::move(mapped);
+	}
+
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		arc.set_thread_pool(&pool, 256);
+		y_test_assert(arc.serialize(lazy_samples));
+		y_test_assert(arc.serialize(lazy_sources));
+		y_test_assert(arc.serialize(mapped_sources));
+	}
+
+	core::Vector<LazySample> loaded_samples;
+	core::Vector<std::unique_ptr<Source>> loaded_lazy;
+	core::Vector<std::unique_ptr<Source>> loaded_mapped;
+	{
+		buffer.reset();
+		serde3::ReadableArchive arc(buffer);
+		arc.set_thread_pool(&pool);
+
+		y_test_assert(arc.deserialize(loaded_samples).unwrap() == serde3::Success::Full);
+		y_test_assert(!arc.stats().pooled_segments);
+
+		// Lazy values in segments are loaded right away since the segment copies don't outlive the archive
+		y_test_assert(arc.deserialize(loaded_lazy).unwrap() == serde3::Success::Full);
+		y_test_assert(arc.stats().pooled_segments == 8);
+
+		// Mapped spans can only be read from the buffer itself
+		y_test_assert(arc.deserialize(loaded_mapped).unwrap() == serde3::Success::Full);
+		y_test_assert(arc.stats().pooled_segments == 8);
+		y_test_assert(buffer.at_end());
+	}
+
+	y_test_assert(loaded_samples.size() == 2000 && loaded_lazy.size() == 2000 && loaded_mapped.size() == 2000);
+	for(usize i = 0; i != 2000; ++i) {
+		y_test_assert(!loaded_samples[i].sample.is_loaded());
+		y_test_assert(loaded_samples[i].sample->values == values);
+
+		const auto* lazy = dynamic_cast<const LazySource*>(loaded_lazy[i].get());
+		y_test_assert(lazy && lazy->sample.is_loaded() && lazy->sample->values == values);
+
+		const auto* mapped = dynamic_cast<const MappedSource*>(loaded_mapped[i].get());
+		y_test_assert(mapped && std::equal(mapped->values.begin(), mapped->values.end(), values.begin(), values.end()));
+		y_test_assert(reinterpret_cast<const u8*>(mapped->values.data()) > buffer.mapped_data());
+	}
+}
+
+y_test_func("serde3 segmented collection errors") {
+	concurrent::StaticThreadPool pool(4);
+
+	auto shapes = make_shapes(3000);
+	shapes[1234] = std::make_unique<BrokenShape>();
+
+	io2::Buffer buffer;
+	serde3::WritableArchive arc(buffer);
+	arc.set_thread_pool(&pool, 512);
+	y_test_assert(arc.serialize(shapes).is_error());
+
+	// The archive is still usable
+	shapes[1234] = std::make_unique<Circle>();
+	y_test_assert(arc.serialize(shapes));
+}
+
+y_test_func("serde3 table of contents and lazy values") {
+	World world;
+	world.name = "world";
+	world.items = make_items(2000);
+	world.cold = make_items(500);
+
+	for(const serde3::Encoding encoding : {serde3::Encoding::Fixed, serde3::Encoding::Compact}) {
+		io2::Buffer buffer;
+		{
+			serde3::WritableArchive arc(buffer, serde3::WriteMode::Patch, encoding);
+			arc.set_table_of_contents(2);
+			y_test_assert(arc.serialize(world));
+			y_test_assert(arc.serialize(u32(4)));
+		}
+
+		{
+			buffer.reset();
+			serde3::ReadableArchive arc(buffer, encoding);
+			arc.set_table_of_contents(true);
+
+			Item item;
+			y_test_assert(arc.deserialize_entry("items/1234", item).unwrap() == serde3::Success::Full);
+			y_test_assert(item == world.items[1234]);
+
+			// The reader is left after the root
+			u32 next = 0;
+			y_test_assert(arc.deserialize(next));
+			y_test_assert(next == 4);
+			y_test_assert(buffer.at_end());
+
+			buffer.reset();
+			core::String name;
+			y_test_assert(arc.deserialize_entry("name", name));
+			y_test_assert(name == world.name);
+
+			// Too deep for the table
+			buffer.reset();
+			y_test_assert(!arc.deserialize_entry("items/3/name", name));
+			buffer.reset();
+			y_test_assert(!arc.deserialize_entry("missing", name));
+		}
+
+		{
+			buffer.reset();
+			World loaded;
+			serde3::ReadableArchive arc(buffer, encoding);
+			arc.set_table_of_contents(true);
+			y_test_assert(arc.deserialize(loaded).unwrap() == serde3::Success::Full);
+
+			u32 next = 0;
+			y_test_assert(arc.deserialize(next));
+			y_test_assert(next == 4);
+
+			y_test_assert(loaded.name == world.name);
+			y_test_assert(loaded.items == world.items);
+			y_test_assert(!loaded.cold.is_loaded());
+			y_test_assert(loaded.cold.get() == world.cold.get());
+			y_test_assert(loaded.cold.is_loaded());
+			y_test_assert(buffer.at_end());
+		}
+	}
+}
+
+y_test_func("serde3 table of contents and raw arrays") {
+	Sample sample;
+	for(usize i = 0; i != 1000; ++i) {
+		sample.values << float(i);
+	}
+
+	io2::Buffer buffer;
+	{
+		serde3::WritableArchive arc(buffer);
+		arc.set_table_of_contents(2);
+		y_test_assert(arc.serialize(sample));
+	}
+
+	buffer.reset();
+	serde3::ReadableArchive arc(buffer);
+	arc.set_table_of_contents(true);
+
+	// Items of raw arrays are not indexed, but the array can be read as a whole
+	float value = 0.0f;
+	y_test_assert(!arc.deserialize_entry("values/3", value));
+	buffer.reset();
+	core::Vector<float> values;
+	y_test_assert(arc.deserialize_entry("values", values).unwrap() == serde3::Success::Full);
+	y_test_assert(values == sample.values);
+}
+
+y_test_func("serde3 poly type lookup") {
+	using Registry = serde3::detail::PolyType<Shape>;
+	y_test_assert(Registry::registered_type_count() == 2);
+	y_test_assert(dynamic_cast<Circle*>(Registry::create_from_id(serde3::detail::poly_type_id<Circle>()).get()));
+	y_test_assert(dynamic_cast<Square*>(Registry::create_from_name(ct_type_name<Square>()).get()));
+	y_test_assert(!Registry::create_from_id(0));
+	y_test_assert(!Registry::create_from_name("Triangle"));
+
+	// Types registered after the first lookup are found
+	y_test_assert(!Registry::find_type(serde3::detail::poly_type_id<BrokenShape>()));
+	Registry::register_type<BrokenShape>();
+	y_test_assert(Registry::registered_type_count() == 3);
+	y_test_assert(dynamic_cast<BrokenShape*>(Registry::create_from_id(serde3::detail::poly_type_id<BrokenShape>()).get()));
+	y_test_assert(dynamic_cast<BrokenShape*>(Registry::create_from_name(ct_type_name<BrokenShape>()).get()));
+	y_test_assert(dynamic_cast<Circle*>(Registry::create_from_id(serde3::detail::poly_type_id<Circle>()).get()));
+}
+
+}
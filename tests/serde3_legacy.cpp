@@ -0,0 +1,53 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include <y/serde3/archives.h>
+#include <y/io2/Buffer.h>
+
+namespace {
+using namespace y;
+
+// Older layout of the Particle in serde3.cpp: both live in an anonymous namespace and share the same type name
+struct Particle {
+	u32 id = 0;
+	float mass = 0.0f;
+	float x = 0.0f;
+	u32 flags = 0;
+
+	y_serde3(id, mass, x, flags)
+};
+
+}
+
+namespace y {
+
+void write_legacy_particles(io2::Buffer& buffer, usize count, serde3::Encoding encoding) {
+	core::Vector<Particle> particles;
+	for(usize i = 0; i != count; ++i) {
+		particles << Particle{u32(i), float(i) * 0.5f, -float(i), 7};
+	}
+
+	serde3::WritableArchive arc(buffer, serde3::WriteMode::Patch, encoding);
+	y_always_assert(arc.serialize(particles), "Unable to serialize particles");
+}
+
+}
@@ -100,6 +100,15 @@ void StaticThreadPool::process_until_empty() {
 	}
 }
 
+void StaticThreadPool::wait_for(const DependencyGroup& group) {
+	while(!group.is_ready()) {
+		std::unique_lock<std::mutex> lock(_shared_data.lock);
+		if(!process_one(std::move(lock))) {
+			std::this_thread::yield();
+		}
+	}
+}
+
 void StaticThreadPool::schedule(Func&& func, DependencyGroup* on_done, DependencyGroup wait_for) {
 	{
 		const std::unique_lock lock(_shared_data.lock);
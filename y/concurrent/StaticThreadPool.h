@@ -89,6 +89,9 @@ class StaticThreadPool : NonMovable {
 		// Empty means all tasks are scheduled, not done!
 		void process_until_empty();
 
+		// Helps processing tasks until everything in group is done
+		void wait_for(const DependencyGroup& group);
+
 		void schedule(Func&& func, DependencyGroup* on_done = nullptr, DependencyGroup wait_for = DependencyGroup());
 
 		template<typename F, typename R = decltype(std::declval<F>()())>
@@ -30,36 +30,31 @@ SOFTWARE.
 namespace y {
 namespace ecs {
 
-Archetype::Archetype(usize component_count, memory::PolymorphicAllocatorBase* allocator) :
+Archetype::Archetype(usize component_count) :
         _component_count(component_count),
-        _component_infos(std::make_unique<ComponentRuntimeInfo[]>(component_count)),
-		_allocator(allocator) {
+        _component_infos(std::make_unique<ComponentRuntimeInfo[]>(component_count)) {
 }
 
 Archetype::~Archetype() {
 	if(_component_infos) {
-		log_msg(fmt("destroying arch with % components % entities", _component_count, entity_count()));
-		/*for(usize i = 0; i != _component_count; ++i) {
-			log_msg(_component_infos[i].type_name);
-		}*/
-
-
 		y_debug_assert(_chunk_data.is_empty() == !_last_chunk_size);
-		if(!_chunk_data.is_empty()) {
+		for(usize c = 0; c != _chunk_data.size(); ++c) {
+			const usize size = c + 1 == _chunk_data.size() ? _last_chunk_size : _entities_per_chunk;
 			for(usize i = 0; i != _component_count; ++i) {
-				_component_infos[i].destroy_indexed(_chunk_data.last(), 0, _last_chunk_size);
-			}
-			for(usize c = 0; c + 1 < _chunk_data.size(); ++c) {
-				for(usize i = 0; i != _component_count; ++i) {
-					_component_infos[i].destroy_indexed(_chunk_data[c], 0, entities_per_chunk);
+				if(_component_infos[i].has_column()) {
+					_component_infos[i].destroy_indexed(_chunk_data[c], 0, size);
 				}
 			}
+			deallocate_chunk(_chunk_data[c]);
 		}
 
-		for(void* c : _chunk_data) {
-			if(c) {
-				_allocator.deallocate(c, _chunk_byte_size);
+		if(_shared_data) {
+			for(usize i = 0; i != _component_count; ++i) {
+				if(_component_infos[i].shared) {
+					_component_infos[i].destroy(shared_ptr(_component_infos[i]), 1);
+				}
 			}
+			::operator delete(_shared_data, std::align_val_t(_shared_alignment));
 		}
 	}
 }
@@ -68,13 +63,22 @@ usize Archetype::entity_count() const {
 	if(_chunk_data.is_empty()) {
 		return 0;
 	}
-	return (_chunk_data.size() - 1) * entities_per_chunk + _last_chunk_size;
+	return (_chunk_data.size() - 1) * _entities_per_chunk + _last_chunk_size;
 }
 
 usize Archetype::component_count() const {
 	return _component_count;
 }
 
+usize Archetype::entities_per_chunk() const {
+	return _entities_per_chunk;
+}
+
+// Chunk memory, excluding shared components
+usize Archetype::allocated_bytes() const {
+	return _chunk_data.size() * _chunk_byte_size;
+}
+
 core::Span<ComponentRuntimeInfo> Archetype::component_infos() const {
 	return core::Span<ComponentRuntimeInfo>(_component_infos.get(), _component_count);
 }
@@ -88,122 +92,306 @@ void Archetype::add_entities(core::MutableSpan<EntityData> entities) {
 }
 
 void Archetype::add_entities(core::MutableSpan<EntityData> entities, bool update_data) {
-	add_chunk_if_needed();
-
-	const usize left_in_chunk = entities_per_chunk - _last_chunk_size;
-	const usize first = std::min(left_in_chunk, entities.size());
+	const usize start = add_rows(entities.size());
+	construct_rows(start, entities.size());
 
-
-	if(update_data) {
-		const usize start = entity_count();
-		for(usize i = 0; i != first; ++i) {
+	for(usize i = 0; i != entities.size(); ++i) {
+		if(update_data) {
 			entities[i].archetype = this;
 			entities[i].archetype_index = start + i;
+			row_id(start + i) = entities[i].id;
+		} else {
+			row_id(start + i) = EntityID();
 		}
 	}
+}
+
+void Archetype::add_entities(core::Span<EntityID> ids, core::MutableSpan<EntityData> entity_data) {
+	const usize start = add_rows(ids.size());
+	construct_rows(start, ids.size());
+
+	for(usize i = 0; i != ids.size(); ++i) {
+		EntityData& data = entity_data[ids[i].index()];
+		y_debug_assert(data.id == ids[i]);
+		y_debug_assert(!data.archetype);
+		data.archetype = this;
+		data.archetype_index = start + i;
+		row_id(start + i) = ids[i];
+	}
+}
 
-	void* chunk_data = _chunk_data.last();
+void Archetype::remove_entities(core::MutableSpan<EntityID> ids, core::MutableSpan<EntityData> entity_data) {
+	const core::Vector<usize> rows = sort_by_row(ids, entity_data);
 	for(usize i = 0; i != _component_count; ++i) {
-		_component_infos[i].create_indexed(chunk_data, _last_chunk_size, first);
+		destroy_rows(_component_infos[i], rows);
 	}
-	_last_chunk_size += first;
+	erase_rows(rows, entity_data);
 
-	if(first != entities.size()) {
-		add_entities(core::MutableSpan(entities.begin() + first, entities.size() - first));
+	for(const EntityID id : ids) {
+		EntityData& data = entity_data[id.index()];
+		data.archetype = nullptr;
+		data.archetype_index = usize(-1);
 	}
 }
 
-void Archetype::remove_entity(EntityData& data) {
-	y_debug_assert(data.archetype == this);
-
-	if(!_last_chunk_size) {
-		if(_chunk_data.last()) {
-			_allocator.deallocate(_chunk_data.last(), _chunk_byte_size);
+serde3::Result Archetype::save_rows(io2::Writer& writer) const {
+	for(usize i = 0; i != _component_count; ++i) {
+		const ComponentRuntimeInfo& info = _component_infos[i];
+		if(info.shared) {
+			y_try(info.save(writer, shared_ptr(info), 1));
 		}
-		_chunk_data.pop();
-		_last_chunk_size = entities_per_chunk;
 	}
 
-	y_debug_assert(_last_chunk_size != 0);
-	y_debug_assert(!_chunk_data.is_empty());
-	const usize last_index = _last_chunk_size - 1;
-	if(data.archetype_index + 1 != entity_count()) {
-		const usize chunk_index = data.archetype_index / entities_per_chunk;
-		const usize item_index = data.archetype_index % entities_per_chunk;
+	y_try_discard(writer.write_one(u64(_chunk_data.size())));
+	for(usize c = 0; c != _chunk_data.size(); ++c) {
+		const void* chunk = _chunk_data[c];
+		const usize rows = c + 1 == _chunk_data.size() ? _last_chunk_size : _entities_per_chunk;
+
+		y_try_discard(writer.write_one(u64(rows)));
+		y_try_discard(writer.write_array(static_cast<const EntityID*>(chunk), rows));
 		for(usize i = 0; i != _component_count; ++i) {
-			_component_infos[i].move_indexed(_chunk_data[chunk_index], item_index, _chunk_data.last(), last_index, 1);
+			const ComponentRuntimeInfo& info = _component_infos[i];
+			if(info.has_column()) {
+				y_try(info.save(writer, info.index_ptr(const_cast<void*>(chunk), 0), rows));
+			}
 		}
 	}
+	return core::Ok(serde3::Success::Full);
+}
 
-	for(usize i = 0; i != _component_count; ++i) {
-		_component_infos[i].destroy_indexed(_chunk_data.last(), last_index, 1);
+// columns are the components in the order they were saved
+serde3::Result Archetype::load_rows(io2::Reader& reader, core::Span<const ComponentRuntimeInfo*> columns, core::MutableSpan<EntityData> entity_data) {
+	y_debug_assert(columns.size() == _component_count);
+
+	serde3::Success success = serde3::Success::Full;
+	bool failed = false;
+
+	// Shared values overwrite the current ones
+	for(const ComponentRuntimeInfo* info : columns) {
+		if(info->shared) {
+			const serde3::Result result = info->load(reader, shared_ptr(*info), 1);
+			if(result.is_error()) {
+				return core::Err();
+			}
+			success = success | result.unwrap();
+		}
+	}
+
+	// Counts are checked against what is left in the reader before allocating anything,
+	// every chunk has a row count and every row at least an id.
+	u64 chunk_count = 0;
+	y_try_discard(reader.read_one(chunk_count));
+	if(chunk_count > reader.remaining() / sizeof(u64)) {
+		return core::Err();
+	}
+	for(u64 c = 0; c != chunk_count; ++c) {
+		u64 rows = 0;
+		y_try_discard(reader.read_one(rows));
+		if(rows > reader.remaining() / sizeof(EntityID)) {
+			return core::Err();
+		}
+
+		// Saved chunks may not have the same capacity as ours.
+		// Components are constructed first so that a failed load leaves valid objects behind.
+		const usize start = add_rows(rows);
+		construct_rows(start, rows);
+
+		for_each_chunk_run(start, rows, [&](void* chunk, usize item_index, usize run) {
+			failed = failed || reader.read_array(static_cast<EntityID*>(chunk) + item_index, run).is_error();
+		});
+		for(const ComponentRuntimeInfo* info : columns) {
+			if(!info->has_column()) {
+				continue;
+			}
+			for_each_chunk_run(start, rows, [&](void* chunk, usize item_index, usize run) {
+				if(!failed) {
+					const serde3::Result result = info->load(reader, info->index_ptr(chunk, item_index), run);
+					failed = result.is_error();
+					success = failed ? success : success | result.unwrap();
+				}
+			});
+		}
+		if(failed) {
+			return core::Err();
+		}
+
+		for(usize row = start; row != start + rows; ++row) {
+			const EntityID id = row_id(row);
+			if(id.index() >= entity_data.size() || entity_data[id.index()].id != id || entity_data[id.index()].archetype) {
+				return core::Err();
+			}
+			EntityData& data = entity_data[id.index()];
+			data.archetype = this;
+			data.archetype_index = row;
+		}
 	}
-	--_last_chunk_size;
-	data.invalidate();
+	return core::Ok(success);
 }
 
 void Archetype::sort_component_infos() {
 	const auto cmp = [](const ComponentRuntimeInfo& a, const ComponentRuntimeInfo& b) { return a.type_id < b.type_id; };
 	sort(_component_infos.get(), _component_infos.get() + _component_count, cmp);
 
-	y_debug_assert(_chunk_byte_size == 0);
+	usize entity_size = sizeof(EntityID);
 	for(usize i = 0; i != _component_count; ++i) {
-		_component_infos[i].chunk_offset = _chunk_byte_size;
-
-		const usize size = _component_infos[i].component_size;
-		_chunk_byte_size = memory::align_up_to(_chunk_byte_size, size);
-		_chunk_byte_size += size * entities_per_chunk;
-
+		if(_component_infos[i].has_column()) {
+			entity_size += _component_infos[i].component_size;
+		}
+		if(!_component_infos[i].shared) {
+			// Columns are aligned relative to the chunk start, so chunks are allocated on the biggest alignment
+			_chunk_alignment = std::max(_chunk_alignment, _component_infos[i].component_alignment);
+		}
 		if(i && _component_infos[i - 1].type_id == _component_infos[i].type_id) {
 			y_fatal("Duplicated component type: %.", _component_infos[i].type_name);
 		}
 	}
+
+	// Start from an upper bound and remove entities until the padding fits
+	const usize header_size = _component_count * sizeof(u64);
+	usize entities = std::max(usize(1), (chunk_byte_size - std::min(chunk_byte_size, header_size)) / entity_size);
+	while(entities > 1 && set_chunk_layout(entities) > chunk_byte_size) {
+		--entities;
+	}
+
+	_entities_per_chunk = entities;
+	_chunk_byte_size = std::max(chunk_byte_size, set_chunk_layout(entities));
+
+	create_shared_components();
 }
 
-void Archetype::transfer_to(Archetype* other, core::MutableSpan<EntityData> entities) {
-	Y_TODO(We create empty entities just to move into them)
-	const usize start = other->entity_count();
-	other->add_entities(entities, false);
+// Shared components live in a single block owned by the archetype
+void Archetype::create_shared_components() {
+	y_debug_assert(!_shared_data);
 
-	usize other_index = 0;
+	usize byte_size = 0;
 	for(usize i = 0; i != _component_count; ++i) {
-		const ComponentRuntimeInfo& info = _component_infos[i];
-		ComponentRuntimeInfo* other_info = nullptr;
-		for(; other_index != other->_component_count; ++other_index) {
-			if(other->_component_infos[other_index].type_id == info.type_id) {
-				other_info = &other->_component_infos[other_index];
-				break;
+		ComponentRuntimeInfo& info = _component_infos[i];
+		if(info.shared) {
+			byte_size = memory::align_up_to(byte_size, info.component_alignment);
+			info.chunk_offset = byte_size;
+			byte_size += info.component_size;
+			_shared_alignment = std::max(_shared_alignment, info.component_alignment);
+		}
+	}
+
+	if(!byte_size) {
+		return;
+	}
+
+	_shared_data = static_cast<u8*>(::operator new(byte_size, std::align_val_t(_shared_alignment)));
+	for(usize i = 0; i != _component_count; ++i) {
+		if(_component_infos[i].shared) {
+			_component_infos[i].create(shared_ptr(_component_infos[i]), 1);
+		}
+	}
+}
+
+void* Archetype::shared_ptr(const ComponentRuntimeInfo& info) const {
+	y_debug_assert(info.shared && _shared_data);
+	return _shared_data + info.chunk_offset;
+}
+
+// Chunks contain the ids of their entities, the component versions and then the component columns.
+// Tags get a version but no column: all their rows alias the start of the chunk.
+usize Archetype::set_chunk_layout(usize capacity) {
+	usize byte_size = sizeof(EntityID) * capacity;
+	for(usize i = 0; i != _component_count; ++i) {
+		_component_infos[i].version_offset = byte_size;
+		byte_size += sizeof(u64);
+	}
+
+	for(usize i = 0; i != _component_count; ++i) {
+		if(!_component_infos[i].has_column()) {
+			if(!_component_infos[i].shared) {
+				_component_infos[i].chunk_offset = 0;
 			}
+			continue;
 		}
-		if(other_info) {
-			y_debug_assert(other_info->type_id == info.type_id);
-			for(usize e = 0; e != entities.size(); ++e) {
-				EntityData& data = entities[e];
-				const usize src_chunk_index = data.archetype_index / entities_per_chunk;
-				const usize src_item_index = data.archetype_index % entities_per_chunk;
 
-				const usize dst_index = start + e;
-				const usize dst_chunk_index = dst_index / entities_per_chunk;
-				const usize dst_item_index = dst_index % entities_per_chunk;
+		const usize alignment = std::max(chunk_alignment, _component_infos[i].component_alignment);
+		y_debug_assert(alignment % chunk_alignment == 0);
+
+		byte_size = memory::align_up_to(byte_size, alignment);
+		_component_infos[i].chunk_offset = byte_size;
+		byte_size += _component_infos[i].component_size * capacity;
+	}
+	return byte_size;
+}
+
+void Archetype::transfer_to(Archetype* other, core::MutableSpan<EntityID> ids, core::MutableSpan<EntityData> entity_data) {
+	y_debug_assert(other != this);
+
+	const core::Vector<usize> rows = sort_by_row(ids, entity_data);
+	const usize count = ids.size();
+	const usize start = other->add_rows(count);
+	const usize dst_capacity = other->_entities_per_chunk;
+
+	// Both component lists are sorted by type
+	usize src_index = 0;
+	for(usize i = 0; i != other->_component_count; ++i) {
+		const ComponentRuntimeInfo& dst_info = other->_component_infos[i];
+		for(; src_index != _component_count && _component_infos[src_index].type_id < dst_info.type_id; ++src_index) {
+			destroy_rows(_component_infos[src_index], rows);
+		}
 
-				void* dst = other_info->index_ptr(other->_chunk_data[dst_chunk_index], dst_item_index);
-				info.move_indexed(dst, _chunk_data[src_chunk_index], src_item_index, 1);
+		if(!dst_info.has_column()) {
+			if(src_index != _component_count && _component_infos[src_index].type_id == dst_info.type_id) {
+				++src_index;
 			}
+			continue;
+		}
+
+		if(src_index == _component_count || _component_infos[src_index].type_id != dst_info.type_id) {
+			other->for_each_chunk_run(start, count, [&](void* chunk, usize item_index, usize run) {
+				dst_info.create_indexed(chunk, item_index, run);
+			});
+			continue;
+		}
+
+		// Relocate runs of rows that are contiguous on both sides
+		const ComponentRuntimeInfo& src_info = _component_infos[src_index++];
+		for(usize k = 0; k != count;) {
+			const usize src_row = rows[k];
+			const usize dst_row = start + k;
+			const usize max_run = std::min(_entities_per_chunk - src_row % _entities_per_chunk, dst_capacity - dst_row % dst_capacity);
+
+			usize run = 1;
+			while(run != max_run && k + run != count && rows[k + run] == src_row + run) {
+				++run;
+			}
+
+			void* dst = dst_info.index_ptr(other->_chunk_data[dst_row / dst_capacity], dst_row % dst_capacity);
+			void* src = src_info.index_ptr(_chunk_data[src_row / _entities_per_chunk], src_row % _entities_per_chunk);
+			src_info.relocate(dst, src, run);
+			k += run;
 		}
 	}
+	for(; src_index != _component_count; ++src_index) {
+		destroy_rows(_component_infos[src_index], rows);
+	}
 
-	Y_TODO(optimize this with create_from)
-	for(usize e = 0; e != entities.size(); ++e) {
-		EntityData& data = entities[e];
-		const EntityID id = data.id;
-		remove_entity(data);
+	erase_rows(rows, entity_data);
 
-		data.id = id;
+	for(usize k = 0; k != count; ++k) {
+		other->row_id(start + k) = ids[k];
+		EntityData& data = entity_data[ids[k].index()];
 		data.archetype = other;
-		data.archetype_index = start + e;
+		data.archetype_index = start + k;
 	}
 }
 
+std::unique_ptr<Archetype> Archetype::archetype_without(core::Span<u32> type_indexes) const {
+	const auto removed = [&](const ComponentRuntimeInfo& info) {
+		return std::find(type_indexes.begin(), type_indexes.end(), info.type_id) != type_indexes.end();
+	};
+	const usize count = std::count_if(_component_infos.get(), _component_infos.get() + _component_count, removed);
+
+	auto arc = std::make_unique<Archetype>(_component_count - count);
+	std::copy_if(_component_infos.get(), _component_infos.get() + _component_count, arc->_component_infos.get(), [&](const ComponentRuntimeInfo& info) { return !removed(info); });
+	arc->sort_component_infos();
+	return arc;
+}
+
 bool Archetype::matches_type_indexes(core::Span<u32> type_indexes) const {
 	y_debug_assert(std::is_sorted(type_indexes.begin(), type_indexes.end()));
 	if(type_indexes.size() != _component_count) {
@@ -217,23 +405,200 @@ bool Archetype::matches_type_indexes(core::Span<u32> type_indexes) const {
 	return true;
 }
 
-void Archetype::add_chunk_if_needed() {
-	if(_last_chunk_size == entities_per_chunk || _chunk_data.is_empty()) {
-		add_chunk();
+usize Archetype::add_rows(usize count) {
+	// New or moved rows need to be checked again
+	_sort_dest.clear();
+	_sort_tick = 0;
+	const usize start = entity_count();
+	while(count) {
+		if(_chunk_data.is_empty() || _last_chunk_size == _entities_per_chunk) {
+			add_chunk();
+		}
+		touch_chunk(_chunk_data.last());
+		const usize added = std::min(count, _entities_per_chunk - _last_chunk_size);
+		_last_chunk_size += added;
+		count -= added;
 	}
+	return start;
+}
+
+void Archetype::construct_rows(usize first, usize count) {
+	for_each_chunk_run(first, count, [this](void* chunk, usize item_index, usize run) {
+		for(usize i = 0; i != _component_count; ++i) {
+			if(_component_infos[i].has_column()) {
+				_component_infos[i].create_indexed(chunk, item_index, run);
+			}
+		}
+	});
+}
+
+void Archetype::destroy_rows(const ComponentRuntimeInfo& info, core::Span<usize> rows) {
+	if(!info.has_column()) {
+		return;
+	}
+	for(const usize row : rows) {
+		info.destroy_indexed(_chunk_data[row / _entities_per_chunk], row % _entities_per_chunk, 1);
+	}
+}
+
+// Components of the erased rows must already be destroyed or relocated.
+// Holes are filled with the last rows, rows needs to be sorted.
+void Archetype::erase_rows(core::Span<usize> rows, core::MutableSpan<EntityData> entity_data) {
+	_sort_dest.clear();
+	_sort_tick = 0;
+	for(usize r = rows.size(); r != 0; --r) {
+		const usize row = rows[r - 1];
+		const usize last = entity_count() - 1;
+		y_debug_assert(row <= last);
+
+		touch_chunk(_chunk_data[row / _entities_per_chunk]);
+
+		if(row != last) {
+			for(usize i = 0; i != _component_count; ++i) {
+				if(!_component_infos[i].has_column()) {
+					continue;
+				}
+				_component_infos[i].relocate_indexed(_chunk_data[row / _entities_per_chunk], row % _entities_per_chunk, _chunk_data.last(), _last_chunk_size - 1, 1);
+			}
+
+			const EntityID moved = row_id(row) = row_id(last);
+			if(moved.is_valid()) {
+				EntityData& data = entity_data[moved.index()];
+				y_debug_assert(data.archetype == this && data.archetype_index == last);
+				data.archetype_index = row;
+			}
+		}
+
+		pop_row();
+	}
+}
+
+void Archetype::pop_row() {
+	y_debug_assert(_last_chunk_size);
+	if(!--_last_chunk_size) {
+		deallocate_chunk(_chunk_data.pop());
+		_last_chunk_size = _chunk_data.is_empty() ? 0 : _entities_per_chunk;
+	}
+}
+
+void Archetype::swap_rows(usize a, usize b, void* scratch, core::MutableSpan<EntityData> entity_data) {
+	void* chunk_a = _chunk_data[a / _entities_per_chunk];
+	void* chunk_b = _chunk_data[b / _entities_per_chunk];
+	for(usize i = 0; i != _component_count; ++i) {
+		const ComponentRuntimeInfo& info = _component_infos[i];
+		if(info.has_column()) {
+			void* ptr_a = info.index_ptr(chunk_a, a % _entities_per_chunk);
+			void* ptr_b = info.index_ptr(chunk_b, b % _entities_per_chunk);
+			info.relocate(scratch, ptr_a, 1);
+			info.relocate(ptr_a, ptr_b, 1);
+			info.relocate(ptr_b, scratch, 1);
+		}
+	}
+	touch_chunk(chunk_a);
+	touch_chunk(chunk_b);
+
+	std::swap(row_id(a), row_id(b));
+	for(const usize row : {a, b}) {
+		if(const EntityID id = row_id(row); id.is_valid()) {
+			y_debug_assert(entity_data[id.index()].archetype == this);
+			entity_data[id.index()].archetype_index = row;
+		}
+	}
+}
+
+// Resumes the pending sort, the sort is dropped once every row is in place
+bool Archetype::apply_sort_moves(usize& budget, core::MutableSpan<EntityData> entity_data) {
+	usize scratch_size = 1;
+	usize scratch_alignment = 1;
+	for(usize i = 0; i != _component_count; ++i) {
+		scratch_size = std::max(scratch_size, _component_infos[i].component_size);
+		scratch_alignment = std::max(scratch_alignment, _component_infos[i].component_alignment);
+	}
+	void* scratch = ::operator new(scratch_size, std::align_val_t(scratch_alignment));
+
+	for(; _sort_cursor != _sort_dest.size(); ++_sort_cursor) {
+		const usize row = _sort_cursor;
+		while(_sort_dest[row] != row && budget) {
+			const usize other = _sort_dest[row];
+			swap_rows(row, other, scratch, entity_data);
+			std::swap(_sort_dest[row], _sort_dest[other]);
+			--budget;
+		}
+		if(_sort_dest[row] != row) {
+			break;
+		}
+	}
+
+	::operator delete(scratch, std::align_val_t(scratch_alignment));
+
+	if(_sort_cursor != _sort_dest.size()) {
+		return false;
+	}
+	_sort_dest.clear();
+	return true;
+}
+
+// Rows moved by the sort are written at the current tick, which doesn't make them dirty again
+bool Archetype::is_sort_dirty(const ComponentRuntimeInfo& info) const {
+	if(!_sort_tick) {
+		return true;
+	}
+	for(void* chunk : _chunk_data) {
+		if(info.chunk_version(chunk) > _sort_tick) {
+			return true;
+		}
+	}
+	return false;
+}
+
+void Archetype::reset_sort(u32 type_id) {
+	_sort_dest.clear();
+	_sort_type = type_id;
+	_sort_tick = 0;
+}
+
+EntityID& Archetype::row_id(usize row) {
+	return static_cast<EntityID*>(_chunk_data[row / _entities_per_chunk])[row % _entities_per_chunk];
+}
+
+void Archetype::touch_chunk(void* chunk) {
+	for(usize i = 0; i != _component_count; ++i) {
+		_component_infos[i].chunk_version(chunk) = _tick;
+	}
+}
+
+core::Vector<usize> Archetype::sort_by_row(core::MutableSpan<EntityID> ids, core::Span<EntityData> entity_data) const {
+	const auto row = [&](EntityID id) { return entity_data[id.index()].archetype_index; };
+	sort(ids.begin(), ids.end(), [&](EntityID a, EntityID b) { return row(a) < row(b); });
+
+	auto rows = core::vector_with_capacity<usize>(ids.size());
+	for(const EntityID id : ids) {
+		y_debug_assert(entity_data[id.index()].archetype == this);
+		rows << row(id);
+	}
+	return rows;
 }
 
 void Archetype::add_chunk() {
 	y_debug_assert(_chunk_byte_size != 0);
-	y_debug_assert(_last_chunk_size == entities_per_chunk || _chunk_data.is_empty());
+	y_debug_assert(_last_chunk_size == _entities_per_chunk || _chunk_data.is_empty());
 
 	_last_chunk_size = 0;
-	_chunk_data.emplace_back(_chunk_byte_size ? _allocator.allocate(_chunk_byte_size) : nullptr);
+	_chunk_data.emplace_back(allocate_chunk());
 
 #ifdef Y_DEBUG
 	std::memset(_chunk_data.last(), 0xBA, _chunk_byte_size);
 #endif
 }
 
+void* Archetype::allocate_chunk() {
+	y_debug_assert(_pool);
+	return _pool->allocate(_chunk_byte_size, _chunk_alignment);
+}
+
+void Archetype::deallocate_chunk(void* chunk) {
+	_pool->deallocate(chunk, _chunk_byte_size, _chunk_alignment);
+}
+
 }
 }
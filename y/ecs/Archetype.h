@@ -24,13 +24,16 @@ SOFTWARE.
 
 #include "ComponentView.h"
 #include "ComponentSerializer.h"
+#include "ChunkPool.h"
 
 #include <y/core/Range.h>
 #include <y/core/Vector.h>
-#include <y/mem/allocators.h>
+#include <y/core/HashMap.h>
 
 #include <y/serde3/serde.h>
 
+#include <numeric>
+
 namespace y {
 namespace ecs {
 
@@ -49,6 +52,9 @@ class Archetype : NonMovable {
 		usize entity_count() const;
 		usize component_count() const;
 
+		usize entities_per_chunk() const;
+		usize allocated_bytes() const;
+
 		core::Span<ComponentRuntimeInfo> component_infos() const;
 
 		void add_entity(EntityData& data);
@@ -66,7 +72,7 @@ class Archetype : NonMovable {
 
 	public:
 		// This can not be private because of make_unique
-		Archetype(usize component_count = 0, memory::PolymorphicAllocatorBase* allocator = memory::global_allocator());
+		Archetype(usize component_count = 0);
 
 		/*y_serde3(serde3::property(this, &Archetype::create_serializers, &Archetype::set_serializers),
 				 serde3::property(this, &Archetype::entity_count,		&Archetype::set_entity_count),
@@ -75,14 +81,127 @@ class Archetype : NonMovable {
 	private:
 		friend class EntityWorld;
 
+		template<typename... Args>
+		friend class Query;
+
+		template<typename... Args>
+		friend class ViewSource;
+
+		// Reuses the offsets found by build_iterator
+		template<typename... Args>
+		ComponentView<Args...> view(ComponentIterator<Args...> it) {
+			it._index = 0;
+			it._chunks = _chunk_data.begin();
+			it._tick = _tick;
+			it._shared = _shared_data;
+			return ComponentView<Args...>(it, entity_count());
+		}
+
 		void add_entities(core::MutableSpan<EntityData> entities, bool update_data);
 
+		// entity_data is the world's entity table, indexed by EntityID::index()
+		void add_entities(core::Span<EntityID> ids, core::MutableSpan<EntityData> entity_data);
+		void remove_entities(core::MutableSpan<EntityID> ids, core::MutableSpan<EntityData> entity_data);
+		void transfer_to(Archetype* other, core::MutableSpan<EntityID> ids, core::MutableSpan<EntityData> entity_data);
+
+		// Sorts the rows by key(const T&), swapping at most budget pairs of rows. Swaps are subtracted from budget.
+		// Returns true if no row is out of order. The order is computed once and kept across calls,
+		// and sorted rows are only checked again once a chunk of T has been written to after the tick they were checked at.
+		template<typename T, typename F>
+		bool sort_rows(F&& key, usize& budget, core::MutableSpan<EntityData> entity_data) {
+			using key_type = remove_cvref_t<decltype(key(std::declval<const T&>()))>;
+
+			const ComponentRuntimeInfo* info = info_or_null<T>();
+			y_debug_assert(info);
+			if(_sort_type != info->type_id) {
+				reset_sort(info->type_id);
+			}
+
+			if(_sort_dest.is_empty()) {
+				if(!is_sort_dirty(*info)) {
+					return true;
+				}
+
+				auto keys = core::vector_with_capacity<key_type>(entity_count());
+				for(const auto& [component] : view<const T>()) {
+					keys.emplace_back(key(component));
+				}
+				if(std::is_sorted(keys.begin(), keys.end())) {
+					_sort_tick = _tick;
+					return true;
+				}
+
+				core::Vector<usize> order(keys.size(), 0);
+				std::iota(order.begin(), order.end(), 0);
+				std::stable_sort(order.begin(), order.end(), [&](usize a, usize b) { return keys[a] < keys[b]; });
+
+				// Rows already in the range of their key never move
+				_sort_dest = core::Vector<usize>(keys.size(), usize(-1));
+				for(usize begin = 0; begin != order.size();) {
+					usize end = begin + 1;
+					while(end != order.size() && !(keys[order[begin]] < keys[order[end]])) {
+						++end;
+					}
+					for(usize i = begin; i != end; ++i) {
+						if(order[i] >= begin && order[i] < end) {
+							_sort_dest[order[i]] = order[i];
+						}
+					}
+					usize slot = begin;
+					for(usize i = begin; i != end; ++i) {
+						if(_sort_dest[order[i]] == usize(-1)) {
+							while(_sort_dest[slot] == slot) {
+								++slot;
+							}
+							_sort_dest[order[i]] = slot++;
+						}
+					}
+					begin = end;
+				}
+				_sort_cursor = 0;
+				_sort_tick = _tick;
+			}
+
+			return apply_sort_moves(budget, entity_data);
+		}
+
+		serde3::Result save_rows(io2::Writer& writer) const;
+		serde3::Result load_rows(io2::Reader& reader, core::Span<const ComponentRuntimeInfo*> columns, core::MutableSpan<EntityData> entity_data);
+
 		void sort_component_infos();
-		void transfer_to(Archetype* other, core::MutableSpan<EntityData> entities);
+		usize set_chunk_layout(usize capacity);
+		void create_shared_components();
+		void* shared_ptr(const ComponentRuntimeInfo& info) const;
 		bool matches_type_indexes(core::Span<u32> type_indexes) const;
-		void add_chunk_if_needed();
+
+		usize add_rows(usize count);
+		void construct_rows(usize first, usize count);
+		void destroy_rows(const ComponentRuntimeInfo& info, core::Span<usize> rows);
+		void erase_rows(core::Span<usize> rows, core::MutableSpan<EntityData> entity_data);
+		void pop_row();
+		void swap_rows(usize a, usize b, void* scratch, core::MutableSpan<EntityData> entity_data);
+		bool apply_sort_moves(usize& budget, core::MutableSpan<EntityData> entity_data);
+		bool is_sort_dirty(const ComponentRuntimeInfo& info) const;
+		void reset_sort(u32 type_id);
+		EntityID& row_id(usize row);
+		void touch_chunk(void* chunk);
+		core::Vector<usize> sort_by_row(core::MutableSpan<EntityID> ids, core::Span<EntityData> entity_data) const;
+
 		void add_chunk();
-		void remove_entity(EntityData& data);
+		void* allocate_chunk();
+		void deallocate_chunk(void* chunk);
+
+		// Calls func(chunk, item_index, count) for each chunk overlapping the rows [first, first + count)
+		template<typename F>
+		void for_each_chunk_run(usize first, usize count, F&& func) {
+			while(count) {
+				const usize item_index = first % _entities_per_chunk;
+				const usize run = std::min(count, _entities_per_chunk - item_index);
+				func(_chunk_data[first / _entities_per_chunk], item_index, run);
+				first += run;
+				count -= run;
+			}
+		}
 
 
 
@@ -104,13 +223,10 @@ class Archetype : NonMovable {
 		template<typename T>
 		const ComponentRuntimeInfo* info_or_null() const {
 			const u32 index = type_index<T>();
-			Y_TODO(binary search?)
-			for(usize i = 0; i != _component_count; ++i) {
-				if(_component_infos[i].type_id == index) {
-					return &_component_infos[i];
-				}
-			}
-			return nullptr;
+			const ComponentRuntimeInfo* begin = _component_infos.get();
+			const ComponentRuntimeInfo* end = begin + _component_count;
+			const ComponentRuntimeInfo* it = std::lower_bound(begin, end, index, [](const ComponentRuntimeInfo& info, u32 i) { return info.type_id < i; });
+			return it != end && it->type_id == index ? it : nullptr;
 		}
 
 		template<typename T>
@@ -132,9 +248,13 @@ class Archetype : NonMovable {
 					return false;
 				}
 				it._offsets[I] = type_info->chunk_offset;
+				it._version_offsets[I] = type_info->version_offset;
 				return build_iterator<I + 1>(it);
 			} else {
 				it._chunks = _chunk_data.begin();
+				it._chunk_capacity = _entities_per_chunk;
+				it._tick = _tick;
+				it._shared = _shared_data;
 			}
 			return true;
 		}
@@ -150,6 +270,8 @@ class Archetype : NonMovable {
 		}
 
 
+		std::unique_ptr<Archetype> archetype_without(core::Span<u32> type_indexes) const;
+
 		core::Vector<std::unique_ptr<ComponentInfoSerializerBase>> create_serializers() const {
 			auto serializers =  core::vector_with_capacity<std::unique_ptr<ComponentInfoSerializerBase>>(_component_count);
 			for(usize i = 0; i != _component_count; ++i) {
@@ -190,8 +312,27 @@ class Archetype : NonMovable {
 		core::Vector<void*> _chunk_data;
 		usize _last_chunk_size = 0;
 
-		memory::PolymorphicAllocatorContainer _allocator;
+		ChunkPool* _pool = nullptr;
 		usize _chunk_byte_size = 0;
+		usize _chunk_alignment = chunk_alignment;
+		usize _entities_per_chunk = 0;
+
+		u8* _shared_data = nullptr;
+		usize _shared_alignment = 1;
+
+		// Copy of the world tick, used to version chunk writes
+		u64 _tick = 0;
+
+		// Pending sort: _sort_dest[row] is the final position of row, rows before _sort_cursor are in place.
+		// _sort_tick is the tick at which the keys of _sort_type were last read, 0 if they never were.
+		core::Vector<usize> _sort_dest;
+		usize _sort_cursor = 0;
+		u32 _sort_type = u32(-1);
+		u64 _sort_tick = 0;
+
+		// Cached transitions, keyed by type_set_index. Removing edges can lead to nullptr (no components left)
+		core::ExternalHashMap<u32, Archetype*> _add_edges;
+		core::ExternalHashMap<u32, Archetype*> _remove_edges;
 };
 
 
@@ -0,0 +1,80 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "ChunkPool.h"
+
+namespace y {
+namespace ecs {
+
+ChunkPool::ChunkPool(memory::PolymorphicAllocatorBase* allocator) : _allocator(allocator) {
+}
+
+ChunkPool::~ChunkPool() {
+	trim();
+}
+
+void* ChunkPool::allocate(usize size, usize alignment) {
+	y_debug_assert(alignment >= chunk_alignment && alignment % chunk_alignment == 0);
+	if(size == chunk_byte_size && alignment == chunk_alignment && !_free_chunks.is_empty()) {
+		return _free_chunks.pop();
+	}
+	return allocate_aligned(size, alignment);
+}
+
+void ChunkPool::deallocate(void* chunk, usize size, usize alignment) {
+	if(size == chunk_byte_size && alignment == chunk_alignment) {
+		_free_chunks << chunk;
+	} else {
+		deallocate_aligned(chunk, size, alignment);
+	}
+}
+
+usize ChunkPool::free_chunk_count() const {
+	return _free_chunks.size();
+}
+
+void ChunkPool::trim() {
+	for(void* chunk : _free_chunks) {
+		deallocate_aligned(chunk, chunk_byte_size, chunk_alignment);
+	}
+	_free_chunks.clear();
+}
+
+// The allocator only guarantees max_alignment, so we over allocate and keep the original pointer just before the chunk
+void* ChunkPool::allocate_aligned(usize size, usize alignment) {
+	static_assert(chunk_alignment >= sizeof(void*));
+	u8* raw = static_cast<u8*>(_allocator.allocate(size + alignment));
+	if(!raw) {
+		y_fatal("Unable to allocate chunk.");
+	}
+	void** chunk = reinterpret_cast<void**>(memory::align_up_to(usize(raw) + sizeof(void*), alignment));
+	chunk[-1] = raw;
+	return chunk;
+}
+
+void ChunkPool::deallocate_aligned(void* chunk, usize size, usize alignment) {
+	void* raw = static_cast<void**>(chunk)[-1];
+	_allocator.deallocate(raw, size + alignment);
+}
+
+}
+}
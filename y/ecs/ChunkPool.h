@@ -0,0 +1,61 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_ECS_CHUNKPOOL_H
+#define Y_ECS_CHUNKPOOL_H
+
+#include "ecs.h"
+
+#include <y/core/Vector.h>
+#include <y/mem/allocators.h>
+
+namespace y {
+namespace ecs {
+
+// Keeps released chunks of chunk_byte_size bytes so that archetypes of a world can reuse them.
+// Bigger chunks (for archetypes where a single entity doesn't fit the budget) are not pooled.
+// Chunks are aligned on chunk_alignment, or on the alignment given to allocate for over aligned components
+// (those chunks are not pooled). Not thread safe.
+class ChunkPool : NonMovable {
+	public:
+		ChunkPool(memory::PolymorphicAllocatorBase* allocator = memory::global_allocator());
+		~ChunkPool();
+
+		void* allocate(usize size, usize alignment = chunk_alignment);
+		void deallocate(void* chunk, usize size, usize alignment = chunk_alignment);
+
+		usize free_chunk_count() const;
+
+		// Gives the free chunks back to the allocator
+		void trim();
+
+	private:
+		void* allocate_aligned(usize size, usize alignment);
+		void deallocate_aligned(void* chunk, usize size, usize alignment);
+
+		core::Vector<void*> _free_chunks;
+		memory::PolymorphicAllocatorContainer _allocator;
+};
+
+}
+}
+
+#endif // Y_ECS_CHUNKPOOL_H
@@ -0,0 +1,102 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_ECS_COMMANDBUFFER_H
+#define Y_ECS_COMMANDBUFFER_H
+
+#include "EntityWorld.h"
+
+#include <y/concurrent/SpinLock.h>
+
+#include <mutex>
+
+namespace y {
+namespace ecs {
+
+// Records structural changes to be played back later using EntityWorld::apply.
+// Recording is thread safe so that parallel systems can share a buffer.
+class CommandBuffer : NonCopyable {
+	public:
+		// Created entities only get their ids during playback
+		template<typename... Args>
+		void create_entities(usize count = 1) {
+			resolve_func resolve = nullptr;
+			if constexpr(sizeof...(Args)) {
+				resolve = &EntityWorld::archetype_with_added<Args...>;
+			}
+			const std::unique_lock lock(_lock);
+			_creates.emplace_back(CreateCommand{count, resolve});
+		}
+
+		void remove_entity(EntityID id);
+
+		template<typename T>
+		void add_component(EntityID id) {
+			add_components<T>(id);
+		}
+
+		template<typename... Args>
+		void add_components(EntityID id) {
+			static_assert(sizeof...(Args));
+			push(Command{id, &EntityWorld::archetype_with_added<Args...>});
+		}
+
+		template<typename T>
+		void remove_component(EntityID id) {
+			remove_components<T>(id);
+		}
+
+		template<typename... Args>
+		void remove_components(EntityID id) {
+			static_assert(sizeof...(Args));
+			push(Command{id, &EntityWorld::archetype_with_removed<Args...>});
+		}
+
+		bool is_empty() const;
+		void clear();
+
+	private:
+		friend class EntityWorld;
+
+		using resolve_func = Archetype* (EntityWorld::*)(Archetype*);
+
+		struct Command {
+			EntityID id;
+			// nullptr means that the entity is removed
+			resolve_func resolve = nullptr;
+		};
+
+		struct CreateCommand {
+			usize count = 0;
+			resolve_func resolve = nullptr;
+		};
+
+		void push(Command command);
+
+		concurrent::SpinLock _lock;
+		core::Vector<Command> _commands;
+		core::Vector<CreateCommand> _creates;
+};
+
+}
+}
+
+#endif // Y_ECS_COMMANDBUFFER_H
@@ -25,12 +25,18 @@ SOFTWARE.
 #include "ecs.h"
 
 #include <y/utils/name.h>
+#include <y/serde3/poly.h>
+#include <y/io2/io.h>
 
 #include <memory>
 #include <cstring>
 
 namespace y {
 namespace ecs {
+
+template<typename T>
+class ComponentInfoSerializer;
+
 namespace detail {
 
 template<typename T>
@@ -39,9 +45,15 @@ std::unique_ptr<ComponentInfoSerializerBase> create_info_serializer();
 template<typename T>
 ComponentSerializerWrapper create_component_serializer(Archetype*);
 
+template<typename T>
+serde3::Result save_components(io2::Writer& writer, const void* ptr, usize count);
+
+template<typename T>
+serde3::Result load_components(io2::Reader& reader, void* ptr, usize count);
+
 template<typename T>
 void create_component(void* dst, usize count) {
-	y_debug_assert(usize(dst) % sizeof(T) == 0);
+	y_debug_assert(usize(dst) % alignof(T) == 0);
 	T* it = static_cast<T*>(dst);
 	const T* end = it + count;
 	for(; it != end; ++it) {
@@ -49,15 +61,30 @@ void create_component(void* dst, usize count) {
 	}
 }
 
+// Move constructs into dst and destroys src
 template<typename T>
-void create_component_from(void* dst, void* from) {
-	y_debug_assert(usize(dst) % sizeof(T) == 0);
-	::new(dst) T(std::move(*static_cast<T*>(from)));
+void relocate_component(void* dst, void* src, usize count) {
+	y_debug_assert(usize(dst) % alignof(T) == 0);
+	y_debug_assert(usize(src) % alignof(T) == 0);
+	if constexpr(std::is_trivially_copyable_v<T>) {
+		std::memcpy(dst, src, count * sizeof(T));
+	} else {
+		T* it = static_cast<T*>(src);
+		const T* end = it + count;
+		T* out = static_cast<T*>(dst);
+		for(; it != end; ++it, ++out) {
+			::new(out) T(std::move(*it));
+			it->~T();
+		}
+	}
+#ifdef Y_DEBUG
+	std::memset(src, 0xFE, count * sizeof(T));
+#endif
 }
 
 template<typename T>
 void destroy_component(void* ptr, usize count) {
-	y_debug_assert(usize(ptr) % sizeof(T) == 0);
+	y_debug_assert(usize(ptr) % alignof(T) == 0);
 	T* it = static_cast<T*>(ptr);
 	const T* end = it + count;
 	for(; it != end; ++it) {
@@ -70,7 +97,7 @@ void destroy_component(void* ptr, usize count) {
 
 template<typename T>
 void move_component(void* dst, void* src, usize count) {
-	y_debug_assert(usize(dst) % sizeof(T) == 0);
+	y_debug_assert(usize(dst) % alignof(T) == 0);
 	T* it = static_cast<T*>(src);
 	const T* end = it + count;
 	T* out = static_cast<T*>(dst);
@@ -83,19 +110,32 @@ void move_component(void* dst, void* src, usize count) {
 
 
 struct ComponentRuntimeInfo {
+	// Offset in the chunk, or in the archetype's shared block for shared components
 	usize chunk_offset = 0;
+	// Offset of the u64 tick at which the component was last written in the chunk
+	usize version_offset = 0;
 	usize component_size = 0;
+	usize component_alignment = 0;
+	bool shared = false;
 
 	void (*create)(void* dst, usize count) = nullptr;
-	void (*create_from)(void* dst, void* from) = nullptr;
+	void (*relocate)(void* dst, void* src, usize count) = nullptr;
 	void (*destroy)(void* ptr, usize count) = nullptr;
 	void (*move)(void* dst, void* src, usize count) = nullptr;
 
 	std::unique_ptr<ComponentInfoSerializerBase> (*create_info_serializer)() = nullptr;
 	ComponentSerializerWrapper (*create_component_serializer)(Archetype*) = nullptr;
 
+	// Trivially copyable components are written as raw bytes.
+	// load expects constructed components, except for trivially copyable ones.
+	serde3::Result (*save)(io2::Writer& writer, const void* ptr, usize count) = nullptr;
+	serde3::Result (*load)(io2::Reader& reader, void* ptr, usize count) = nullptr;
+
 	u32 type_id = u32(-1);
 
+	// Unlike type_id this is stable across runs
+	serde3::TypeId serialized_type_id = 0;
+
 	std::string_view type_name = "unknown";
 
 
@@ -103,30 +143,44 @@ struct ComponentRuntimeInfo {
 	static ComponentRuntimeInfo from_type(usize offset = 0) {
 		return {
 			offset,
-			sizeof(T),
+			0,
+			is_tag_v<T> ? 0 : sizeof(T),
+			alignof(T),
+			is_shared_v<T>,
 			detail::create_component<T>,
-			detail::create_component_from<T>,
+			detail::relocate_component<T>,
 			detail::destroy_component<T>,
 			detail::move_component<T>,
 			detail::create_info_serializer<T>,
 			detail::create_component_serializer<T>,
+			detail::save_components<T>,
+			detail::load_components<T>,
 			type_index<T>(),
+			serde3::detail::poly_type_id<ComponentInfoSerializer<T>>(),
 			ct_type_name<T>()
 		};
 	}
 
 
+	// Tags and shared components have no column in the chunks
+	bool has_column() const {
+		return component_size && !shared;
+	}
 
 	void* index_ptr(void* chunk, usize index) const {
 		return static_cast<u8*>(chunk) + chunk_offset + index * component_size;
 	}
 
+	u64& chunk_version(void* chunk) const {
+		return *reinterpret_cast<u64*>(static_cast<u8*>(chunk) + version_offset);
+	}
+
 	void create_indexed(void* chunk, usize index, usize count) const {
 		create(index_ptr(chunk, index), count);
 	}
 
-	void create_from_indexed(void* chunk, usize index, void* from) const {
-		create_from(index_ptr(chunk, index), from);
+	void relocate_indexed(void* dst_chunk, usize dst_index, void* src_chunk, usize src_index, usize count) const {
+		relocate(index_ptr(dst_chunk, dst_index), index_ptr(src_chunk, src_index), count);
 	}
 
 	void destroy_indexed(void* chunk, usize index, usize count) const {
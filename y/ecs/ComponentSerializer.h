@@ -41,6 +41,9 @@ struct ComponentInfoSerializerBase : NonMovable {
 	//y_serde3_poly_base(ComponentInfoSerializerBase)
 };
 
+// Every component type is registered here, under ComponentRuntimeInfo::serialized_type_id
+using ComponentTypeRegistry = serde3::detail::PolyType<ComponentInfoSerializerBase>;
+
 template<typename T>
 class ComponentInfoSerializer : public ComponentInfoSerializerBase {
 	public:
@@ -48,6 +51,7 @@ class ComponentInfoSerializer : public ComponentInfoSerializerBase {
 		}
 
 		ComponentRuntimeInfo create_runtime_info() const override {
+			_registrar.used();
 			return ComponentRuntimeInfo::from_type<T>();
 		}
 
@@ -55,6 +59,12 @@ class ComponentInfoSerializer : public ComponentInfoSerializerBase {
 		//y_serde3(u32(17))
 
 	private:
+		inline static struct Registrar {
+			Registrar() {
+				ComponentTypeRegistry::register_type<ComponentInfoSerializer<T>>();
+			}
+			void used() {}
+		} _registrar;
 };
 
 class ComponentSerializerBase : NonMovable {
@@ -141,6 +151,39 @@ ComponentSerializerWrapper create_component_serializer(Archetype* arc) {
 	return ComponentSerializerWrapper::create<T>(arc);
 }
 
+template<typename T>
+serde3::Result save_components(io2::Writer& writer, const void* ptr, usize count) {
+	const T* components = static_cast<const T*>(ptr);
+	if constexpr(std::is_trivially_copyable_v<T>) {
+		y_try_discard(writer.write_array(components, count));
+	} else {
+		serde3::WritableArchive arc(writer);
+		for(usize i = 0; i != count; ++i) {
+			y_try(arc.serialize(components[i]));
+		}
+	}
+	return core::Ok(serde3::Success::Full);
+}
+
+template<typename T>
+serde3::Result load_components(io2::Reader& reader, void* ptr, usize count) {
+	T* components = static_cast<T*>(ptr);
+	serde3::Success success = serde3::Success::Full;
+	if constexpr(std::is_trivially_copyable_v<T>) {
+		y_try_discard(reader.read_array(components, count));
+	} else {
+		serde3::ReadableArchive arc(reader);
+		for(usize i = 0; i != count; ++i) {
+			const serde3::Result result = arc.deserialize(components[i]);
+			if(result.is_error()) {
+				return core::Err();
+			}
+			success = success | result.unwrap();
+		}
+	}
+	return core::Ok(success);
+}
+
 }
 
 }
@@ -25,8 +25,10 @@ SOFTWARE.
 #include "ecs.h"
 
 #include <y/core/Range.h>
+#include <y/core/Span.h>
 
 #include <tuple>
+#include <array>
 #include <type_traits>
 
 namespace y {
@@ -35,6 +37,12 @@ namespace ecs {
 template<typename... Args>
 class ComponentIterator;
 
+template<typename... Args>
+struct ComponentView;
+
+template<typename... Args>
+using ComponentSpans = std::tuple<core::MutableSpan<Args>...>;
+
 class ComponentEndIterator {
 	public:
 		using difference_type = usize;
@@ -89,7 +97,14 @@ class ComponentIterator {
 		ComponentIterator(const ComponentIterator&) = default;
 
 		template<typename... A, typename = std::enable_if_t<is_compatible<0, A...>()>>
-		ComponentIterator(const ComponentIterator<A...>& other) : _index(other._index), _chunks(other._chunks), _offsets(other._offsets) {
+		ComponentIterator(const ComponentIterator<A...>& other) :
+				_index(other._index),
+				_chunks(other._chunks),
+				_offsets(other._offsets),
+				_version_offsets(other._version_offsets),
+				_chunk_capacity(other._chunk_capacity),
+				_tick(other._tick),
+				_shared(other._shared) {
 		}
 
 		reference operator*() const {
@@ -168,26 +183,77 @@ class ComponentIterator {
 		template<typename... A>
 		friend class ComponentIterator;
 
+		template<typename... A>
+		friend struct ComponentView;
+
 		template<usize I = 0>
 		auto make_refence_tuple() const {
 			y_debug_assert(_chunks || !sizeof...(Args));
-			const usize chunk_index = _index / entities_per_chunk;
-			const usize item_index = _index % entities_per_chunk;
+			const usize chunk_index = _index / _chunk_capacity;
+			const usize item_index = _index % _chunk_capacity;
 			using type = std::remove_reference_t<std::tuple_element_t<I, reference>>;
 
-			void* offset_chunk = static_cast<u8*>(_chunks[chunk_index]) + _offsets[I];
-			type* chunk = static_cast<type*>(offset_chunk);
+			touch<type>(chunk_index, I);
+			type& component = is_shared_v<type>
+				? *static_cast<type*>(component_ptr<type>(chunk_index, I))
+				: static_cast<type*>(component_ptr<type>(chunk_index, I))[item_index];
 			if constexpr(I + 1 == component_count) {
-				return std::tie(chunk[item_index]);
+				return std::tie(component);
 			} else {
-				return std::tuple_cat(std::tie(chunk[item_index]),
+				return std::tuple_cat(std::tie(component),
 				                      make_refence_tuple<I + 1>());
 			}
 		}
 
+		template<usize I = 0>
+		auto make_span_tuple(usize chunk_index, usize count) const {
+			y_debug_assert(_chunks || !sizeof...(Args));
+			using type = std::remove_reference_t<std::tuple_element_t<I, reference>>;
+
+			touch<type>(chunk_index, I);
+			// Shared components yield a single element
+			const auto span = core::MutableSpan<type>(static_cast<type*>(component_ptr<type>(chunk_index, I)), is_shared_v<type> ? 1 : count);
+			if constexpr(I + 1 == component_count) {
+				return std::tuple(span);
+			} else {
+				return std::tuple_cat(std::tuple(span), make_span_tuple<I + 1>(chunk_index, count));
+			}
+		}
+
+		template<typename T>
+		void* component_ptr(usize chunk_index, usize component) const {
+			if constexpr(is_shared_v<T>) {
+				y_debug_assert(_shared);
+				return _shared + _offsets[component];
+			} else {
+				return static_cast<u8*>(_chunks[chunk_index]) + _offsets[component];
+			}
+		}
+
+		// Mutable accesses mark the component as written in the chunk
+		template<typename T>
+		void touch(usize chunk_index, usize component) const {
+			if constexpr(!std::is_const_v<T>) {
+				*reinterpret_cast<u64*>(static_cast<u8*>(_chunks[chunk_index]) + _version_offsets[component]) = _tick;
+			}
+		}
+
+		bool changed_since(usize chunk_index, u64 tick) const {
+			for(const usize offset : _version_offsets) {
+				if(*reinterpret_cast<const u64*>(static_cast<const u8*>(_chunks[chunk_index]) + offset) >= tick) {
+					return true;
+				}
+			}
+			return false;
+		}
+
 		usize _index = 0;
 		void** _chunks = nullptr;
 		std::array<usize, component_count> _offsets;
+		std::array<usize, component_count> _version_offsets;
+		usize _chunk_capacity = 1;
+		u64 _tick = 0;
+		u8* _shared = nullptr;
 };
 
 static_assert(std::is_constructible_v<ComponentIterator<const int>, ComponentIterator<int>>);
@@ -225,6 +291,34 @@ struct ComponentView : ComponentViewRange<Args...> {
 		y_debug_assert(index < this->size());
 		return *(this->begin() + index);
 	}
+
+	// Number of entities in a full chunk
+	usize chunk_capacity() const {
+		return this->begin()._chunk_capacity;
+	}
+
+	usize chunk_count() const {
+		y_debug_assert(this->begin()._index == 0);
+		const usize capacity = chunk_capacity();
+		return (this->size() + capacity - 1) / capacity;
+	}
+
+	usize chunk_size(usize chunk_index) const {
+		y_debug_assert(chunk_index < chunk_count());
+		const usize first = chunk_index * chunk_capacity();
+		return std::min(chunk_capacity(), this->size() - first);
+	}
+
+	// Components of the chunk are contiguous, all spans have chunk_size elements except for shared components
+	ComponentSpans<Args...> chunk(usize chunk_index) const {
+		return this->begin().make_span_tuple(chunk_index, chunk_size(chunk_index));
+	}
+
+	// True if any of the components has been written in the chunk at or after tick
+	bool chunk_changed_since(usize chunk_index, u64 tick) const {
+		y_debug_assert(chunk_index < chunk_count());
+		return this->begin().changed_since(chunk_index, tick);
+	}
 };
 
 }
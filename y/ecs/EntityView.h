@@ -29,6 +29,46 @@ SOFTWARE.
 namespace y {
 namespace ecs {
 
+template<typename... Args>
+struct ArchetypeMatch {
+	Archetype* archetype = nullptr;
+	ComponentIterator<Args...> iterator;
+};
+
+// Archetypes visited by the iterators: either all the archetypes of a world, matched while iterating,
+// or the ones already matched by a Query
+template<typename... Args>
+class ViewSource {
+	public:
+		ViewSource() = default;
+
+		ViewSource(core::Span<std::unique_ptr<Archetype>> archetypes) : _archetypes(archetypes) {
+		}
+
+		ViewSource(core::Span<ArchetypeMatch<Args...>> matches) : _matches(matches) {
+		}
+
+		usize size() const {
+			return _matches.is_empty() ? _archetypes.size() : _matches.size();
+		}
+
+		ComponentView<Args...> view(usize index) const {
+			if(!_matches.is_empty()) {
+				const ArchetypeMatch<Args...>& match = _matches[index];
+				return match.archetype->view(match.iterator);
+			}
+			return _archetypes[index]->template view<Args...>();
+		}
+
+		bool operator==(const ViewSource& other) const {
+			return _archetypes.data() == other._archetypes.data() && _matches.data() == other._matches.data();
+		}
+
+	private:
+		core::Span<std::unique_ptr<Archetype>> _archetypes;
+		core::Span<ArchetypeMatch<Args...>> _matches;
+};
+
 template<typename... Args>
 class EntityIterator {
 
@@ -44,9 +84,9 @@ class EntityIterator {
 
 		using iterator_category = std::forward_iterator_tag;
 
-		EntityIterator(core::Span<std::unique_ptr<Archetype>> archetypes) : _archetypes(archetypes) {
-			if(!_archetypes.is_empty()) {
-				_components = archetype()->template view<Args...>();
+		EntityIterator(ViewSource<Args...> source) : _source(source) {
+			if(_source.size()) {
+				_components = _source.view(0);
 				if(_components.is_empty()) {
 					advance_archetype();
 				}
@@ -62,7 +102,7 @@ class EntityIterator {
 		}
 
 		bool at_end() const {
-			return _archetype_index >= _archetypes.size();
+			return _archetype_index >= _source.size();
 		}
 
 		reference operator*() const {
@@ -94,7 +134,7 @@ class EntityIterator {
 		}
 
 		bool operator==(const EntityIterator& other) const {
-			return _archetypes == other._archetype && _archetype_index == other._archetype_index && _components.size() == other._components.size();
+			return _source == other._source && _archetype_index == other._archetype_index && _components.size() == other._components.size();
 		}
 
 		bool operator!=(const EntityIterator& other) const {
@@ -108,36 +148,129 @@ class EntityIterator {
 				if(at_end()) {
 					break;
 				}
-				_components = archetype()->template view<Args...>();
+				_components = _source.view(_archetype_index);
 			} while(_components.is_empty());
 		}
 
-		const Archetype* archetype() const {
-			return _archetypes[_archetype_index].get();
+		ComponentViewRange<Args...> _components = ComponentView<Args...>();
+
+		usize _archetype_index = 0;
+		ViewSource<Args...> _source;
+};
+
+// Yields (entity count, core::MutableSpan<Args>...) for every chunk
+template<typename... Args>
+class ChunkIterator {
+	public:
+		using difference_type = void;
+		using value_type = std::tuple<usize, core::MutableSpan<Args>...>;
+		using reference = value_type;
+		using pointer = value_type*;
+
+		using iterator_category = std::forward_iterator_tag;
+
+		// Only chunks where one of the components has been written at or after since are visited
+		ChunkIterator(ViewSource<Args...> source, u64 since = 0) : _source(source), _since(since) {
+			if(_source.size()) {
+				_components = _source.view(0);
+				if(!_components.chunk_count()) {
+					advance_archetype();
+				} else {
+					skip_unchanged();
+				}
+			}
+		}
+
+		void advance() {
+			y_debug_assert(!at_end());
+			++_chunk_index;
+			skip_unchanged();
 		}
 
-		Archetype* archetype() {
-			return _archetypes[_archetype_index].get();
+		bool at_end() const {
+			return _archetype_index >= _source.size();
+		}
+
+		reference operator*() const {
+			y_debug_assert(!at_end());
+			return std::tuple_cat(std::tuple(_components.chunk_size(_chunk_index)), _components.chunk(_chunk_index));
+		}
+
+		ChunkIterator& operator++() {
+			advance();
+			return *this;
+		}
+
+		ChunkIterator operator++(int) {
+			const auto it = *this;
+			++*this;
+			return it;
+		}
+
+		bool operator==(const ChunkIterator& other) const {
+			return _source == other._source && _archetype_index == other._archetype_index && _chunk_index == other._chunk_index;
+		}
+
+		bool operator!=(const ChunkIterator& other) const {
+			return !operator==(other);
+		}
+
+	private:
+		void skip_unchanged() {
+			while(!at_end()) {
+				if(_chunk_index == _components.chunk_count()) {
+					advance_archetype();
+				} else if(!_since || _components.chunk_changed_since(_chunk_index, _since)) {
+					break;
+				} else {
+					++_chunk_index;
+				}
+			}
+		}
+
+		void advance_archetype() {
+			_chunk_index = 0;
+			do {
+				++_archetype_index;
+				if(at_end()) {
+					break;
+				}
+				_components = _source.view(_archetype_index);
+			} while(!_components.chunk_count());
 		}
 
 		ComponentView<Args...> _components;
 
+		usize _chunk_index = 0;
 		usize _archetype_index = 0;
-		core::Span<std::unique_ptr<Archetype>> _archetypes;
+		ViewSource<Args...> _source;
+		u64 _since = 0;
 };
 
 template<typename... Args>
 using EntityViewRange = core::Range<EntityIterator<Args...>, EndIterator>;
 
+template<typename... Args>
+using ChunkViewRange = core::Range<ChunkIterator<Args...>, EndIterator>;
+
 template<typename... Args>
 struct EntityView : EntityViewRange<Args...> {
-	EntityView() : EntityView(EntityIterator<Args...>({})) {
+	EntityView() : EntityView(EntityIterator<Args...>(ViewSource<Args...>())) {
 	}
 
 	EntityView(EntityIterator<Args...> beg) : EntityViewRange<Args...>(std::move(beg), EndIterator()) {
 	}
 };
 
+template<typename... Args>
+struct ChunkView : ChunkViewRange<Args...> {
+	ChunkView() : ChunkView(ChunkIterator<Args...>(ViewSource<Args...>())) {
+	}
+
+	ChunkView(ChunkIterator<Args...> beg) : ChunkViewRange<Args...>(std::move(beg), EndIterator()) {
+	}
+};
+
 }
 }
 
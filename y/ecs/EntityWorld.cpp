@@ -21,34 +21,57 @@ SOFTWARE.
 **********************************/
 
 #include "EntityWorld.h"
+#include "CommandBuffer.h"
+
+#include <y/utils/hash.h>
+#include <y/utils/perf.h>
 
 namespace y {
 namespace ecs {
 
+static constexpr u32 snapshot_magic = 0x53434559; // "YECS"
+static constexpr u32 snapshot_version = 2;
+
+
 bool EntityWorld::exists(EntityID id) const {
 	if(id.index() >= _entities.size()) {
 		return false;
 	}
-	return _entities[id.index()].id.version() == id.version();
+	const EntityData& data = _entities[id.index()];
+	return data.is_valid() && data.id.version() == id.version();
 }
 
 EntityID EntityWorld::create_entity() {
-	_entities.emplace_back();
-	EntityData& data = _entities.last();
-	return data.id = EntityID(_entities.size() - 1);
+	EntityID id;
+	if(_free_slots.is_empty()) {
+		id = EntityID(u32(_entities.size()));
+		_entities.emplace_back();
+	} else {
+		// Bump the version so that ids of the previous entity are no longer valid
+		const u32 index = _free_slots.pop();
+		id = EntityID(index, _entities[index].id.version() + 1);
+	}
+
+	EntityData& data = _entities[id.index()];
+	y_debug_assert(!data.is_valid() && !data.archetype);
+	data.id = id;
+	data.alive_index = _alive.size();
+	_alive << id;
+	return id;
 }
 
 void EntityWorld::remove_entity(EntityID id) {
 	check_exists(id);
 
 	EntityData& data = _entities[id.index()];
-	if(!data.archetype) {
-		data.invalidate();
-	} else {
-		data.archetype->remove_entity(data);
+	if(data.archetype) {
+		data.archetype->remove_entities(id, _entities);
 	}
-	y_debug_assert(!data.archetype);
-	y_debug_assert(!data.is_valid());
+	release_entity(data);
+}
+
+core::Span<EntityID> EntityWorld::entity_ids() const {
+	return _alive;
 }
 
 
@@ -56,20 +79,317 @@ core::Span<std::unique_ptr<Archetype>> EntityWorld::archetypes() const {
 	return _archetypes;
 }
 
+const ChunkPool& EntityWorld::chunk_pool() const {
+	return *_chunk_pool;
+}
+
+u64 EntityWorld::tick() const {
+	return _tick;
+}
+
+u64 EntityWorld::advance_tick() {
+	++_tick;
+	for(const auto& arc : _archetypes) {
+		arc->_tick = _tick;
+	}
+	return _tick;
+}
+
 void EntityWorld::transfer(EntityData& data, Archetype* to) {
 	y_debug_assert(exists(data.id));
 	y_debug_assert(data.archetype != to);
 
-	if(data.archetype) {
-		data.archetype->transfer_to(to, data);
+	EntityID id = data.id;
+	if(!to) {
+		data.archetype->remove_entities(id, _entities);
+	} else if(data.archetype) {
+		data.archetype->transfer_to(to, id, _entities);
 	} else {
-		to->add_entity(data);
+		to->add_entities(core::Span<EntityID>(id), _entities);
 	}
 
 	y_debug_assert(data.archetype == to);
 	y_debug_assert(exists(data.id));
 }
 
+void EntityWorld::apply(CommandBuffer& buffer) {
+	y_profile();
+
+	for(const CommandBuffer::CreateCommand& create : buffer._creates) {
+		auto ids = core::vector_with_capacity<EntityID>(create.count);
+		for(usize i = 0; i != create.count; ++i) {
+			ids << create_entity();
+		}
+		if(create.resolve) {
+			(this->*create.resolve)(nullptr)->add_entities(ids, _entities);
+		}
+	}
+
+	struct Move {
+		Archetype* from;
+		Archetype* to;
+		bool removed;
+		EntityID id;
+
+		auto key() const {
+			return std::tuple(usize(from), usize(to), removed);
+		}
+	};
+
+	// Fold the commands of each entity, in the order they were recorded
+	core::Vector<Move> moves;
+	{
+		auto& commands = buffer._commands;
+		std::stable_sort(commands.begin(), commands.end(), [](const auto& a, const auto& b) { return a.id.as_u64() < b.id.as_u64(); });
+
+		for(usize i = 0; i != commands.size();) {
+			const EntityID id = commands[i].id;
+			const bool alive = exists(id);
+
+			Archetype* from = alive ? _entities[id.index()].archetype : nullptr;
+			Archetype* to = from;
+			bool removed = false;
+			for(; i != commands.size() && commands[i].id == id; ++i) {
+				if(!commands[i].resolve) {
+					removed = true;
+				} else if(alive && !removed) {
+					to = (this->*commands[i].resolve)(to);
+				}
+			}
+
+			if(alive && (removed || from != to)) {
+				moves << Move{from, removed ? nullptr : to, removed, id};
+			}
+		}
+	}
+
+	sort(moves.begin(), moves.end(), [](const Move& a, const Move& b) { return a.key() < b.key(); });
+
+	core::Vector<EntityID> ids;
+	for(usize i = 0; i != moves.size();) {
+		const Move& group = moves[i];
+		ids.make_empty();
+		for(; i != moves.size() && moves[i].key() == group.key(); ++i) {
+			ids << moves[i].id;
+		}
+
+		if(group.from && group.to) {
+			group.from->transfer_to(group.to, ids, _entities);
+		} else if(group.from) {
+			group.from->remove_entities(ids, _entities);
+		} else if(group.to) {
+			group.to->add_entities(ids, _entities);
+		}
+
+		if(group.removed) {
+			for(const EntityID id : ids) {
+				release_entity(_entities[id.index()]);
+			}
+		}
+	}
+
+	buffer.clear();
+}
+
+void EntityWorld::release_entity(EntityData& data) {
+	y_debug_assert(!data.archetype);
+	y_debug_assert(_alive[data.alive_index] == data.id);
+
+	const EntityID moved = _alive[data.alive_index] = _alive.last();
+	_entities[moved.index()].alive_index = data.alive_index;
+	_alive.pop();
+
+	_free_slots << data.id.index();
+	data.invalidate();
+	data.alive_index = usize(-1);
+	y_debug_assert(!data.is_valid());
+}
+
+serde3::Result EntityWorld::save(io2::Writer& writer) const {
+	y_profile();
+
+	y_try_discard(writer.write_one(snapshot_magic));
+	y_try_discard(writer.write_one(snapshot_version));
+
+	{
+		auto ids = core::vector_with_capacity<EntityID>(_entities.size());
+		for(const EntityData& data : _entities) {
+			ids << data.id;
+		}
+		y_try_discard(writer.write_one(u64(ids.size())));
+		y_try_discard(writer.write_array(ids.data(), ids.size()));
+	}
+
+	const auto is_empty = [](const auto& arc) { return !arc->entity_count(); };
+	y_try_discard(writer.write_one(u64(_archetypes.size() - std::count_if(_archetypes.begin(), _archetypes.end(), is_empty))));
+	for(const auto& arc : _archetypes) {
+		if(is_empty(arc)) {
+			continue;
+		}
+
+		y_try_discard(writer.write_one(u64(arc->component_count())));
+		for(const ComponentRuntimeInfo& info : arc->component_infos()) {
+			y_try_discard(writer.write_one(info.serialized_type_id));
+			y_try_discard(writer.write_one(u64(info.component_size)));
+		}
+		y_try(arc->save_rows(writer));
+	}
+
+	return core::Ok(serde3::Success::Full);
+}
+
+serde3::Result EntityWorld::load(io2::Reader& reader) {
+	y_profile();
+
+	if(!_entities.is_empty()) {
+		y_fatal("Snapshots can only be loaded in an empty world.");
+	}
+
+	u32 magic = 0;
+	u32 version = 0;
+	y_try_discard(reader.read_one(magic));
+	y_try_discard(reader.read_one(version));
+	if(magic != snapshot_magic || version != snapshot_version) {
+		return core::Err();
+	}
+
+	{
+		u64 slot_count = 0;
+		y_try_discard(reader.read_one(slot_count));
+		if(slot_count > reader.remaining() / sizeof(EntityID)) {
+			return core::Err();
+		}
+		core::Vector<EntityID> ids(slot_count, EntityID());
+		y_try_discard(reader.read_array(ids.data(), ids.size()));
+
+		_entities = core::Vector<EntityData>(slot_count, EntityData());
+		for(usize i = 0; i != ids.size(); ++i) {
+			EntityData& data = _entities[i];
+			data.id = ids[i];
+			if(!data.is_valid()) {
+				_free_slots << u32(i);
+			} else if(data.id.index() == i) {
+				data.alive_index = _alive.size();
+				_alive << data.id;
+			} else {
+				return core::Err();
+			}
+		}
+	}
+
+	serde3::Success success = serde3::Success::Full;
+
+	u64 archetype_count = 0;
+	y_try_discard(reader.read_one(archetype_count));
+	for(u64 a = 0; a != archetype_count; ++a) {
+		u64 component_count = 0;
+		y_try_discard(reader.read_one(component_count));
+		if(component_count > reader.remaining() / (sizeof(serde3::TypeId) + sizeof(u64))) {
+			return core::Err();
+		}
+
+		core::Vector<ComponentRuntimeInfo> infos;
+		auto types = core::vector_with_capacity<u32>(component_count);
+		for(u64 c = 0; c != component_count; ++c) {
+			serde3::TypeId type_id = 0;
+			u64 component_size = 0;
+			y_try_discard(reader.read_one(type_id));
+			y_try_discard(reader.read_one(component_size));
+
+			const auto serializer = ComponentTypeRegistry::create_from_id(type_id);
+			if(!serializer) {
+				return core::Err();
+			}
+			infos << serializer->create_runtime_info();
+			if(infos.last().component_size != component_size) {
+				return core::Err();
+			}
+			types << infos.last().type_id;
+		}
+
+		sort(types.begin(), types.end());
+		if(types.is_empty() || std::adjacent_find(types.begin(), types.end()) != types.end()) {
+			return core::Err();
+		}
+
+		Archetype* arc = find_archetype(types);
+		if(!arc) {
+			auto new_arc = std::make_unique<Archetype>(infos.size());
+			std::copy(infos.begin(), infos.end(), new_arc->_component_infos.get());
+			new_arc->sort_component_infos();
+			arc = add_archetype(std::move(new_arc));
+		}
+
+		auto columns = core::vector_with_capacity<const ComponentRuntimeInfo*>(infos.size());
+		for(const ComponentRuntimeInfo& saved : infos) {
+			const auto arc_infos = arc->component_infos();
+			columns << std::find_if(arc_infos.begin(), arc_infos.end(), [&](const ComponentRuntimeInfo& info) { return info.type_id == saved.type_id; });
+		}
+
+		const serde3::Result result = arc->load_rows(reader, columns, _entities);
+		if(result.is_error()) {
+			return core::Err();
+		}
+		success = success | result.unwrap();
+	}
+
+	return core::Ok(success);
+}
+
+Archetype* EntityWorld::find_archetype(core::Span<u32> type_indexes) const {
+	if(const auto it = _archetype_map.find(type_set_hash(type_indexes)); it != _archetype_map.end()) {
+		for(Archetype* arc : it->second) {
+			if(arc->matches_type_indexes(type_indexes)) {
+				return arc;
+			}
+		}
+	}
+	return nullptr;
+}
+
+Archetype* EntityWorld::find_or_create_archetype_without(Archetype* arc, core::Span<u32> type_indexes) {
+	core::Vector types = core::vector_with_capacity<u32>(arc->component_count());
+	for(const ComponentRuntimeInfo& info : arc->component_infos()) {
+		if(std::find(type_indexes.begin(), type_indexes.end(), info.type_id) == type_indexes.end()) {
+			types << info.type_id;
+		}
+	}
+
+	if(types.is_empty()) {
+		return nullptr;
+	}
+	if(types.size() == arc->component_count()) {
+		return arc;
+	}
+	if(Archetype* existing = find_archetype(types)) {
+		return existing;
+	}
+	return add_archetype(arc->archetype_without(type_indexes));
+}
+
+Archetype* EntityWorld::add_archetype(std::unique_ptr<Archetype> arc) {
+	core::Vector types = core::vector_with_capacity<u32>(arc->component_count());
+	for(const ComponentRuntimeInfo& info : arc->component_infos()) {
+		types << info.type_id;
+	}
+	y_debug_assert(!find_archetype(types));
+
+	arc->_tick = _tick;
+	arc->_pool = _chunk_pool.get();
+	Archetype* ptr = _archetypes.emplace_back(std::move(arc)).get();
+	_archetype_map[type_set_hash(types)] << ptr;
+	return ptr;
+}
+
+u64 EntityWorld::type_set_hash(core::Span<u32> type_indexes) {
+	y_debug_assert(std::is_sorted(type_indexes.begin(), type_indexes.end()));
+	u64 hash = 0xa4c3a9e1d8b6f5e7;
+	for(const u32 index : type_indexes) {
+		hash_combine(hash, u64(index));
+	}
+	return hash;
+}
+
 void EntityWorld::check_exists(EntityID id) const {
 	if(!exists(id)) {
 		y_fatal("Entity doesn't exists.");
@@ -24,8 +24,9 @@ SOFTWARE.
 
 #include "EntityView.h"
 
+#include <y/concurrent/StaticThreadPool.h>
+
 #include <y/utils/sort.h>
-#include <y/utils/iter.h>
 
 namespace y {
 namespace ecs {
@@ -38,19 +39,80 @@ class EntityWorld : NonCopyable {
 		void remove_entity(EntityID id);
 
 		core::Span<std::unique_ptr<Archetype>> archetypes() const;
+		const ChunkPool& chunk_pool() const;
+
+		// Component writes are versioned with the current tick, advance it once per frame
+		u64 tick() const;
+		u64 advance_tick();
 
 
 
 		template<typename... Args>
 		EntityView<Args...> view() {
-			return EntityView<Args...>(_archetypes);
+			return EntityView<Args...>(EntityIterator<Args...>(archetypes()));
+		}
+
+		// Component columns are contiguous and aligned on chunk_alignment
+		template<typename... Args>
+		ChunkView<Args...> chunk_view() {
+			return ChunkView<Args...>(ChunkIterator<Args...>(archetypes()));
+		}
+
+		// Only yields chunks where one of Args has been written at or after since
+		template<typename... Args>
+		ChunkView<Args...> changed_chunk_view(u64 since) {
+			return ChunkView<Args...>(ChunkIterator<Args...>(archetypes(), since));
+		}
+
+		// func is called concurrently with the components of one entity: func(Args&...)
+		template<typename... Args, typename F>
+		void parallel_for_each(concurrent::StaticThreadPool& pool, F&& func) {
+			static_assert(!(is_shared_v<Args> && ...), "At least one component must be stored per entity");
+			parallel_for_each_chunk<Args...>(pool, [&func](core::MutableSpan<Args>... spans) {
+				// Shared components have a single element
+				const usize size = std::max({spans.size()...});
+				for(usize i = 0; i != size; ++i) {
+					func(spans[is_shared_v<Args> ? 0 : i]...);
+				}
+			});
 		}
 
-		auto entity_ids() const {
-			auto ids = TransformIterator(_entities.begin(), [](const EntityData& data) { return data.id; });
-			return core::Range(FilterIterator(ids, _entities.end(), [](EntityID id) { return id.is_valid(); }), EndIterator());
+		// func is called concurrently with the components of a whole chunk: func(core::MutableSpan<Args>...)
+		template<typename... Args, typename F>
+		void parallel_for_each_chunk(concurrent::StaticThreadPool& pool, F&& func) {
+			static_assert(sizeof...(Args));
+
+			struct ChunkRef {
+				ComponentView<Args...> view;
+				usize index;
+			};
+
+			core::Vector<ChunkRef> chunks;
+			for(const auto& arc : _archetypes) {
+				const ComponentView<Args...> view = arc->view<Args...>();
+				for(usize i = 0; i != view.chunk_count(); ++i) {
+					chunks.emplace_back(ChunkRef{view, i});
+				}
+			}
+
+			// A few tasks per thread to balance partially filled chunks
+			const usize task_count = std::min(chunks.size(), std::max(usize(1), pool.concurency() * 4));
+
+			concurrent::DependencyGroup group;
+			for(usize t = 0; t != task_count; ++t) {
+				const usize begin = chunks.size() * t / task_count;
+				const usize end = chunks.size() * (t + 1) / task_count;
+				pool.schedule([&chunks, &func, begin, end] {
+					for(usize i = begin; i != end; ++i) {
+						std::apply(func, chunks[i].view.chunk(chunks[i].index));
+					}
+				}, &group);
+			}
+			pool.wait_for(group);
 		}
 
+		core::Span<EntityID> entity_ids() const;
+
 
 
 		template<typename T>
@@ -60,7 +122,7 @@ class EntityWorld : NonCopyable {
 
 		template<typename T>
 		const T* component(EntityID id) const {
-			return find_component<T>(id);
+			return find_component<const T>(id);
 		}
 
 
@@ -75,50 +137,120 @@ class EntityWorld : NonCopyable {
 			check_exists(id);
 
 			EntityData& data = _entities[id.index()];
-			Archetype* old_arc = data.archetype;
-			Archetype* new_arc = nullptr;
+			Archetype* new_arc = archetype_with_added<Args...>(data.archetype);
+			if(new_arc != data.archetype) {
+				transfer(data, new_arc);
+			}
+		}
 
-			core::Vector types = core::vector_with_capacity<u32>((old_arc ? old_arc->component_count() : 0) + sizeof...(Args));
-			{
-				{
-					if(old_arc) {
-						for(const ComponentRuntimeInfo& info : old_arc->component_infos()) {
-							types << info.type_id;
-						}
-					}
-					add_type_indexes<0, Args...>(types);
-					sort(types.begin(), types.end());
-				}
+		template<typename T>
+		void remove_component(EntityID id) {
+			remove_components<T>(id);
+		}
 
-				for(const auto& arc : _archetypes) {
-					if(arc->matches_type_indexes(types)) {
-						new_arc = arc.get();
-						break;
-					}
-				}
+		template<typename... Args>
+		void remove_components(EntityID id) {
+			check_exists(id);
 
-				if(!new_arc) {
-					if(old_arc) {
-						new_arc = _archetypes.emplace_back(old_arc->archetype_with<Args...>()).get();
-					} else {
-						new_arc = _archetypes.emplace_back(Archetype::create<Args...>()).get();
-					}
+			EntityData& data = _entities[id.index()];
+			Archetype* new_arc = archetype_with_removed<Args...>(data.archetype);
+			if(new_arc != data.archetype) {
+				transfer(data, new_arc);
+			}
+		}
+
+
+		// Plays back and clears the buffer, entities moving between the same archetypes are moved together
+		void apply(CommandBuffer& buffer);
+
+
+		// Reorders the entities of every archetype containing T by key(const T&) (ex: a spatial cell or a parent id).
+		// At most max_swaps pairs of rows are swapped, returns true once no entity is out of order.
+		// Progress is kept across calls and sorted archetypes are skipped until T is written to in a later tick, so this can run every frame.
+		// Writes to T made after this in the same tick are only seen once T is written to again, so this should run after the systems writing T.
+		// Chunks stay densely packed so sorting is the only defragmentation needed.
+		template<typename T, typename F>
+		bool sort_entities(F&& key, usize max_swaps = usize(-1)) {
+			bool sorted = true;
+			for(const auto& arc : _archetypes) {
+				if(arc->info_or_null<T>()) {
+					sorted &= arc->sort_rows<T>(key, max_swaps, _entities);
 				}
 			}
-			y_debug_assert(new_arc->_component_count == types.size());
-			transfer(data, new_arc);
+			return sorted;
 		}
 
 
+		// Binary snapshot of all entities and components, trivially copyable components are written as raw chunk columns.
+		// Snapshots can only be loaded in an empty world, which is left in an unspecified state if loading fails.
+		serde3::Result save(io2::Writer& writer) const;
+		serde3::Result load(io2::Reader& reader);
+
+
 		y_serde3(_archetypes)
 
 	private:
 		friend class ComponentInfoSerializerBase;
 		friend class EntityWorldSerializer;
+		friend class CommandBuffer;
 
 		void check_exists(EntityID id) const;
 
 		void transfer(EntityData& data, Archetype* to);
+		void release_entity(EntityData& data);
+
+		Archetype* find_archetype(core::Span<u32> type_indexes) const;
+		Archetype* find_or_create_archetype_without(Archetype* arc, core::Span<u32> type_indexes);
+		Archetype* add_archetype(std::unique_ptr<Archetype> arc);
+
+		static u64 type_set_hash(core::Span<u32> type_indexes);
+
+
+		template<typename... Args>
+		Archetype* archetype_with_added(Archetype* arc) {
+			auto& edges = arc ? arc->_add_edges : _root_edges;
+			if(const auto it = edges.find(type_set_index<Args...>()); it != edges.end()) {
+				return it->second;
+			}
+
+			core::Vector types = core::vector_with_capacity<u32>((arc ? arc->component_count() : 0) + sizeof...(Args));
+			{
+				if(arc) {
+					for(const ComponentRuntimeInfo& info : arc->component_infos()) {
+						types << info.type_id;
+					}
+				}
+				add_type_indexes<0, Args...>(types);
+				sort(types.begin(), types.end());
+			}
+
+			Archetype* new_arc = find_archetype(types);
+			if(!new_arc) {
+				if(arc) {
+					new_arc = add_archetype(arc->archetype_with<Args...>());
+				} else {
+					new_arc = add_archetype(Archetype::create<Args...>());
+				}
+			}
+			y_debug_assert(new_arc->_component_count == types.size());
+			return edges[type_set_index<Args...>()] = new_arc;
+		}
+
+		// Returns nullptr if no component is left
+		template<typename... Args>
+		Archetype* archetype_with_removed(Archetype* arc) {
+			if(!arc) {
+				return nullptr;
+			}
+
+			if(const auto it = arc->_remove_edges.find(type_set_index<Args...>()); it != arc->_remove_edges.end()) {
+				return it->second;
+			}
+
+			core::Vector types = core::vector_with_capacity<u32>(sizeof...(Args));
+			add_type_indexes<0, Args...>(types);
+			return arc->_remove_edges[type_set_index<Args...>()] = find_or_create_archetype_without(arc, types);
+		}
 
 
 		template<usize I, typename... Args>
@@ -151,8 +283,21 @@ class EntityWorld : NonCopyable {
 
 
 
+		// Must outlive the archetypes
+		std::unique_ptr<ChunkPool> _chunk_pool = std::make_unique<ChunkPool>();
+
 		core::Vector<EntityData> _entities;
+		// Indexes of removed entities, reused by create_entity
+		core::Vector<u32> _free_slots;
+		core::Vector<EntityID> _alive;
 		core::Vector<std::unique_ptr<Archetype>> _archetypes;
+
+		// Sorted type set hash to archetypes
+		core::ExternalHashMap<u64, core::Vector<Archetype*>> _archetype_map;
+		// Transitions for entities without components
+		core::ExternalHashMap<u32, Archetype*> _root_edges;
+
+		u64 _tick = 1;
 };
 
 }
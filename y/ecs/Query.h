@@ -0,0 +1,87 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_ECS_QUERY_H
+#define Y_ECS_QUERY_H
+
+#include "EntityWorld.h"
+
+namespace y {
+namespace ecs {
+
+// Keeps the archetypes matching Args along with their component offsets.
+// Archetypes are never destroyed, so updates only match the archetypes created since the previous one.
+// Views returned by a query are invalidated by the next update.
+template<typename... Args>
+class Query {
+	public:
+		static_assert(sizeof...(Args));
+
+		Query() = default;
+
+		void update(const EntityWorld& world) {
+			y_debug_assert(!_world || _world == &world);
+			_world = &world;
+
+			const core::Span<std::unique_ptr<Archetype>> archetypes = world.archetypes();
+			for(; _checked != archetypes.size(); ++_checked) {
+				ArchetypeMatch<Args...> match;
+				match.archetype = archetypes[_checked].get();
+				if(match.archetype->template build_iterator<0>(match.iterator)) {
+					_matches << match;
+				}
+			}
+		}
+
+		core::Span<ArchetypeMatch<Args...>> matches() const {
+			return _matches;
+		}
+
+		EntityView<Args...> view(EntityWorld& world) {
+			update(world);
+			return EntityView<Args...>(EntityIterator<Args...>(source()));
+		}
+
+		ChunkView<Args...> chunk_view(EntityWorld& world) {
+			update(world);
+			return ChunkView<Args...>(ChunkIterator<Args...>(source()));
+		}
+
+		// Only yields chunks where one of Args has been written at or after since
+		ChunkView<Args...> changed_chunk_view(EntityWorld& world, u64 since) {
+			update(world);
+			return ChunkView<Args...>(ChunkIterator<Args...>(source(), since));
+		}
+
+	private:
+		ViewSource<Args...> source() const {
+			return ViewSource<Args...>(matches());
+		}
+
+		const EntityWorld* _world = nullptr;
+		usize _checked = 0;
+		core::Vector<ArchetypeMatch<Args...>> _matches;
+};
+
+}
+}
+
+#endif // Y_ECS_QUERY_H
@@ -0,0 +1,78 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "System.h"
+
+namespace y {
+namespace ecs {
+
+template<typename T>
+static bool intersects(const T& a, const T& b) {
+	auto it_a = a.begin();
+	auto it_b = b.begin();
+	while(it_a != a.end() && it_b != b.end()) {
+		if(*it_a == *it_b) {
+			return true;
+		}
+		if(*it_a < *it_b) {
+			++it_a;
+		} else {
+			++it_b;
+		}
+	}
+	return false;
+}
+
+System::System(const char* name) : _name(name) {
+}
+
+System::~System() {
+}
+
+const char* System::name() const {
+	return _name;
+}
+
+core::Span<u32> System::reads() const {
+	return _reads;
+}
+
+core::Span<u32> System::writes() const {
+	return _writes;
+}
+
+bool System::conflicts_with(const System& other) const {
+	return intersects(writes(), other.writes()) ||
+	       intersects(writes(), other.reads()) ||
+	       intersects(reads(), other.writes());
+}
+
+core::Duration System::last_run_duration() const {
+	return _last_run_duration;
+}
+
+u64 System::last_run_tick() const {
+	return _last_run_tick;
+}
+
+}
+}
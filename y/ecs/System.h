@@ -0,0 +1,122 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_ECS_SYSTEM_H
+#define Y_ECS_SYSTEM_H
+
+#include "Query.h"
+
+#include <y/core/Chrono.h>
+
+namespace y {
+namespace ecs {
+
+// Systems declare what they access through their view arguments: const T is a read, T is a write.
+// Systems must not create or remove entities or components while the scheduler runs them.
+class System : NonMovable {
+	public:
+		virtual ~System();
+
+		virtual void run(EntityWorld& world) = 0;
+
+		const char* name() const;
+
+		core::Span<u32> reads() const;
+		core::Span<u32> writes() const;
+
+		bool conflicts_with(const System& other) const;
+
+		core::Duration last_run_duration() const;
+
+		// World tick of the previous run, 0 if the system never ran.
+		// Ticks are compared inclusively, so chunks written during that tick are seen again.
+		u64 last_run_tick() const;
+
+	protected:
+		// Name must have static storage
+		System(const char* name);
+
+		template<typename... Args>
+		void set_access() {
+			(add_access<Args>(), ...);
+			sort(_reads.begin(), _reads.end());
+			sort(_writes.begin(), _writes.end());
+		}
+
+	private:
+		friend class SystemScheduler;
+
+		template<typename T>
+		void add_access() {
+			if constexpr(std::is_const_v<T>) {
+				_reads << type_index<std::remove_const_t<T>>();
+			} else {
+				_writes << type_index<T>();
+			}
+		}
+
+		const char* _name = nullptr;
+
+		core::Vector<u32> _reads;
+		core::Vector<u32> _writes;
+
+		core::Duration _last_run_duration;
+		u64 _last_run_tick = 0;
+};
+
+template<typename F, typename... Args>
+class EntityViewSystem final : public System {
+	public:
+		EntityViewSystem(const char* name, F&& func) : System(name), _func(y_fwd(func)) {
+			set_access<Args...>();
+		}
+
+		void run(EntityWorld& world) override {
+			_func(_query.view(world));
+		}
+
+	private:
+		std::remove_reference_t<F> _func;
+		Query<Args...> _query;
+};
+
+template<typename F, typename... Args>
+class ChunkViewSystem final : public System {
+	public:
+		// If changed_only is set, only the chunks written since the previous run are visited
+		ChunkViewSystem(const char* name, F&& func, bool changed_only = false) : System(name), _func(y_fwd(func)), _changed_only(changed_only) {
+			set_access<Args...>();
+		}
+
+		void run(EntityWorld& world) override {
+			_func(_changed_only ? _query.changed_chunk_view(world, last_run_tick()) : _query.chunk_view(world));
+		}
+
+	private:
+		std::remove_reference_t<F> _func;
+		Query<Args...> _query;
+		bool _changed_only = false;
+};
+
+}
+}
+
+#endif // Y_ECS_SYSTEM_H
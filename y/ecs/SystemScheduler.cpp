@@ -0,0 +1,120 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "SystemScheduler.h"
+
+#include <y/utils/log.h>
+#include <y/utils/format.h>
+#include <y/utils/perf.h>
+
+namespace y {
+namespace ecs {
+
+SystemScheduler::SystemScheduler(EntityWorld& world) : _world(world) {
+}
+
+System* SystemScheduler::add_system(std::unique_ptr<System> system) {
+	const usize index = _systems.size();
+	core::Vector<usize> deps;
+
+	// We only need to depend on the closest conflicting systems: anything they conflict with is already waited on
+	for(usize i = index; i != 0; --i) {
+		const usize other = i - 1;
+		if(!system->conflicts_with(*_systems[other])) {
+			continue;
+		}
+		const bool covered = std::any_of(deps.begin(), deps.end(), [&](usize d) {
+			const auto& d_deps = _dependencies[d];
+			return std::find(d_deps.begin(), d_deps.end(), other) != d_deps.end();
+		});
+		if(!covered) {
+			deps << other;
+		}
+	}
+
+	_dependencies.emplace_back(std::move(deps));
+	return _systems.emplace_back(std::move(system)).get();
+}
+
+core::Span<std::unique_ptr<System>> SystemScheduler::systems() const {
+	return _systems;
+}
+
+core::Span<usize> SystemScheduler::dependencies(usize index) const {
+	return _dependencies[index];
+}
+
+void SystemScheduler::run(concurrent::StaticThreadPool& pool) {
+	y_profile();
+
+	const usize count = _systems.size();
+	core::Vector<concurrent::DependencyGroup> done(count, concurrent::DependencyGroup());
+
+	for(usize i = 0; i != count; ++i) {
+		System* system = _systems[i].get();
+		const auto& deps = _dependencies[i];
+
+		concurrent::DependencyGroup wait_for;
+		if(deps.size() == 1) {
+			wait_for = done[deps[0]];
+		} else {
+			// Relay every dependency into a single group since tasks can only wait for one
+			for(const usize d : deps) {
+				pool.schedule([] {}, &wait_for, done[d]);
+			}
+		}
+
+		pool.schedule([this, system] { run_system(system); }, &done[i], wait_for);
+	}
+
+	for(const concurrent::DependencyGroup& group : done) {
+		pool.wait_for(group);
+	}
+
+	_world.advance_tick();
+}
+
+void SystemScheduler::run_sequential() {
+	y_profile();
+	for(const auto& system : _systems) {
+		run_system(system.get());
+	}
+
+	_world.advance_tick();
+}
+
+void SystemScheduler::log_timings() const {
+	for(const auto& system : _systems) {
+		log_msg(fmt("%: %ms", system->name(), system->last_run_duration().to_millis()), Log::Perf);
+	}
+}
+
+void SystemScheduler::run_system(System* system) {
+	y_profile_zone(system->name());
+	const core::Chrono chrono;
+	system->run(_world);
+	system->_last_run_duration = chrono.elapsed();
+	system->_last_run_tick = _world.tick();
+}
+
+}
+}
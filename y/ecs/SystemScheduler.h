@@ -0,0 +1,79 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_ECS_SYSTEMSCHEDULER_H
+#define Y_ECS_SYSTEMSCHEDULER_H
+
+#include "System.h"
+
+namespace y {
+namespace ecs {
+
+// Systems run in registration order, except that systems that don't access the same components
+// (or only read them) run concurrently.
+class SystemScheduler : NonMovable {
+	public:
+		SystemScheduler(EntityWorld& world);
+
+		System* add_system(std::unique_ptr<System> system);
+
+		// func(EntityView<Args...>)
+		template<typename... Args, typename F>
+		System* add_system(const char* name, F&& func) {
+			return add_system(std::make_unique<EntityViewSystem<F, Args...>>(name, y_fwd(func)));
+		}
+
+		// func(ChunkView<Args...>)
+		template<typename... Args, typename F>
+		System* add_chunk_system(const char* name, F&& func) {
+			return add_system(std::make_unique<ChunkViewSystem<F, Args...>>(name, y_fwd(func)));
+		}
+
+		// func(ChunkView<Args...>), only with the chunks where Args have been written since the previous run
+		template<typename... Args, typename F>
+		System* add_changed_chunk_system(const char* name, F&& func) {
+			return add_system(std::make_unique<ChunkViewSystem<F, Args...>>(name, y_fwd(func), true));
+		}
+
+		core::Span<std::unique_ptr<System>> systems() const;
+
+		// Indexes of the earlier systems that index has to wait for
+		core::Span<usize> dependencies(usize index) const;
+
+		// Both advance the world tick once every system has run
+		void run(concurrent::StaticThreadPool& pool);
+		void run_sequential();
+
+		void log_timings() const;
+
+	private:
+		void run_system(System* system);
+
+		EntityWorld& _world;
+
+		core::Vector<std::unique_ptr<System>> _systems;
+		core::Vector<core::Vector<usize>> _dependencies;
+};
+
+}
+}
+
+#endif // Y_ECS_SYSTEMSCHEDULER_H
@@ -33,6 +33,11 @@ u32 next_type_index() {
 	return global_type_index++;
 }
 
+u32 next_type_set_index() {
+	static std::atomic<u32> global_type_set_index = 0;
+	return global_type_set_index++;
+}
+
 }
 }
 }
@@ -23,29 +23,66 @@ SOFTWARE.
 #define Y_ECS_ECS_H
 
 #include <y/utils.h>
+#include <y/serde3/serde.h>
 
 namespace y {
 namespace ecs {
 
 class EntityWorld;
 class Archetype;
+class CommandBuffer;
+class ChunkPool;
 
 class ComponentInfoSerializerBase;
 class ComponentSerializerWrapper;
 
 
-static constexpr usize entities_per_chunk = 1024;
+// Chunks are sized to fit this budget, the number of entities per chunk depends on the archetype
+static constexpr usize chunk_byte_size = 16 * 1024;
+
+// Every component column in a chunk starts on this boundary, or on the component alignment if it is bigger
+static constexpr usize chunk_alignment = 64;
+
+// Components of this type are stored once per archetype instead of once per entity.
+// Every entity of an archetype sees the same value.
+template<typename T>
+struct Shared {
+	T value;
+
+	y_serde3(value)
+};
+
+template<typename T>
+struct IsShared : std::false_type {};
+
+template<typename T>
+struct IsShared<Shared<T>> : std::true_type {};
+
+template<typename T>
+static constexpr bool is_shared_v = IsShared<std::remove_cv_t<T>>::value;
+
+// Empty components (tags) take no space in chunks
+template<typename T>
+static constexpr bool is_tag_v = std::is_empty_v<T>;
 
 namespace detail {
 u32 next_type_index();
+u32 next_type_set_index();
 }
 
 template<typename T>
-static u32 type_index() {
+inline u32 type_index() {
 	static u32 index = detail::next_type_index();
 	return index;
 }
 
+// Identifies a parameter pack, used to cache archetype transitions
+template<typename... Args>
+inline u32 type_set_index() {
+	static u32 index = detail::next_type_set_index();
+	return index;
+}
+
 
 
 class EntityID {
@@ -94,6 +131,7 @@ struct EntityData {
 	EntityID id;
 	Archetype* archetype = nullptr;
 	usize archetype_index = usize(-1);
+	usize alive_index = usize(-1);
 
 	void invalidate() {
 		// Keep the version
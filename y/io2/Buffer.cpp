@@ -92,6 +92,10 @@ ReadUpToResult Buffer::read_all(core::Vector<u8>& data) {
 	return core::Ok(r);
 }
 
+const u8* Buffer::mapped_data() const {
+	return _buffer.data();
+}
+
 WriteResult Buffer::write(const void* data, usize bytes) {
 	const u8* data_bytes = static_cast<const u8*>(data);
 	if(at_end()) {
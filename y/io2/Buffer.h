@@ -46,6 +46,9 @@ class Buffer final : public Reader, public Writer {
 		ReadUpToResult read_up_to(void* data, usize max_bytes) override;
 		ReadUpToResult read_all(core::Vector<u8>& data) override;
 
+		// Invalidated by writes
+		const u8* mapped_data() const override;
+
 		WriteResult write(const void* data, usize bytes) override;
 
 		FlushResult flush() override;
@@ -0,0 +1,337 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "Compressed.h"
+#include "lz.h"
+
+#include <y/concurrent/StaticThreadPool.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace y {
+namespace io2 {
+
+static constexpr u32 compressed_magic = 0x315A4C59; // "YLZ1"
+
+// Set in the stored size of blocks that didn't compress
+static constexpr u32 raw_block_flag = 0x80000000;
+
+struct Footer {
+	u64 index_offset = 0;
+	u32 block_count = 0;
+	u32 magic = 0;
+};
+
+static_assert(sizeof(Footer) == 16);
+
+
+CompressedWriter::CompressedWriter(Writer& inner, usize block_size, concurrent::StaticThreadPool* pool) :
+		_inner(inner),
+		_block_size(std::clamp(block_size, min_block_size, max_block_size)),
+		_pool(pool) {
+
+	const usize slot_count = _pool ? std::max(usize(1), _pool->concurency()) : 1;
+	_pending_capacity = _block_size * slot_count;
+	_pending = std::make_unique<u8[]>(_pending_capacity);
+	for(usize i = 0; i != slot_count; ++i) {
+		_slots.emplace_back(Slot{std::make_unique<u8[]>(lz::compress_bound(_block_size)), 0});
+	}
+}
+
+CompressedWriter::~CompressedWriter() {
+	if(!_finished) {
+		finish().ignore();
+	}
+}
+
+FlushResult CompressedWriter::finish() {
+	y_debug_assert(!_finished);
+	if(!compress_pending()) {
+		return core::Err();
+	}
+
+	const Footer footer{_compressed_size, u32(_index.size()), compressed_magic};
+	for(const u64 entry : _index) {
+		if(!_inner.write_one(entry)) {
+			return core::Err();
+		}
+	}
+	if(!_inner.write_one(footer)) {
+		return core::Err();
+	}
+
+	_finished = true;
+	return _inner.flush();
+}
+
+void CompressedWriter::seek(usize byte) {
+	if(byte != tell()) {
+		y_fatal("Seek in compressed writer.");
+	}
+}
+
+usize CompressedWriter::tell() const {
+	return _raw_size;
+}
+
+FlushResult CompressedWriter::flush() {
+	if(!compress_pending()) {
+		return core::Err();
+	}
+	return _inner.flush();
+}
+
+WriteResult CompressedWriter::write(const void* data, usize bytes) {
+	y_debug_assert(!_finished);
+
+	const u8* src = static_cast<const u8*>(data);
+	usize written = 0;
+	while(written != bytes) {
+		const usize count = std::min(bytes - written, _pending_capacity - _pending_size);
+		std::memcpy(_pending.get() + _pending_size, src + written, count);
+		_pending_size += count;
+		_raw_size += count;
+		written += count;
+
+		if(_pending_size == _pending_capacity && !compress_pending()) {
+			return core::Err(written);
+		}
+	}
+	return core::Ok();
+}
+
+FlushResult CompressedWriter::compress_pending() {
+	const usize block_count = (_pending_size + _block_size - 1) / _block_size;
+	y_debug_assert(block_count <= _slots.size());
+
+	const auto compress_block = [this](usize i) {
+		const usize begin = i * _block_size;
+		const usize size = std::min(_block_size, _pending_size - begin);
+		_slots[i].size = lz::compress(_pending.get() + begin, size, _slots[i].data.get());
+	};
+
+	if(_pool && block_count > 1) {
+		concurrent::DependencyGroup group;
+		for(usize i = 0; i != block_count; ++i) {
+			_pool->schedule([&compress_block, i] { compress_block(i); }, &group);
+		}
+		_pool->wait_for(group);
+	} else {
+		for(usize i = 0; i != block_count; ++i) {
+			compress_block(i);
+		}
+	}
+
+	for(usize i = 0; i != block_count; ++i) {
+		const u8* raw = _pending.get() + i * _block_size;
+		const usize raw_size = std::min(_block_size, _pending_size - i * _block_size);
+
+		// Incompressible blocks are stored as is
+		const bool stored_raw = _slots[i].size >= raw_size;
+		const usize stored_size = stored_raw ? raw_size : _slots[i].size;
+		if(!_inner.write(stored_raw ? raw : _slots[i].data.get(), stored_size)) {
+			return core::Err();
+		}
+
+		const u32 stored = u32(stored_size) | (stored_raw ? raw_block_flag : 0);
+		_index << (u64(raw_size) << 32 | stored);
+		_compressed_size += stored_size;
+	}
+
+	_pending_size = 0;
+	return core::Ok();
+}
+
+
+
+CompressedReader::CompressedReader(CompressedReader&& other) {
+	swap(other);
+}
+
+CompressedReader& CompressedReader::operator=(CompressedReader&& other) {
+	swap(other);
+	return *this;
+}
+
+void CompressedReader::swap(CompressedReader& other) {
+	std::swap(_inner, other._inner);
+	std::swap(_base, other._base);
+	std::swap(_blocks, other._blocks);
+	std::swap(_size, other._size);
+	std::swap(_cursor, other._cursor);
+	std::swap(_loaded, other._loaded);
+	std::swap(_block, other._block);
+	std::swap(_compressed, other._compressed);
+}
+
+core::Result<CompressedReader> CompressedReader::open(Reader& inner) {
+	const usize base = inner.tell();
+	const usize end = base + inner.remaining();
+	if(end - base < sizeof(Footer)) {
+		return core::Err();
+	}
+
+	Footer footer;
+	inner.seek(end - sizeof(Footer));
+	if(!inner.read_one(footer) || footer.magic != compressed_magic) {
+		return core::Err();
+	}
+
+	const usize index_size = usize(footer.block_count) * sizeof(u64);
+	if(footer.index_offset + index_size + sizeof(Footer) != end - base) {
+		return core::Err();
+	}
+
+	CompressedReader reader;
+	reader._inner = &inner;
+	reader._base = base;
+
+	usize max_raw_size = 0;
+	usize max_stored_size = 0;
+
+	inner.seek(base + usize(footer.index_offset));
+	for(u32 i = 0; i != footer.block_count; ++i) {
+		u64 entry = 0;
+		if(!inner.read_one(entry)) {
+			return core::Err();
+		}
+
+		Block block;
+		block.stored_size = u32(entry);
+		block.raw_size = u32(entry >> 32);
+		block.offset = reader._blocks.is_empty() ? 0 : reader._blocks.last().offset + (reader._blocks.last().stored_size & ~raw_block_flag);
+		block.raw_offset = reader._size;
+
+		const usize stored_size = block.stored_size & ~raw_block_flag;
+		if(block.offset + stored_size > footer.index_offset) {
+			return core::Err();
+		}
+
+		max_raw_size = std::max(max_raw_size, usize(block.raw_size));
+		max_stored_size = std::max(max_stored_size, stored_size);
+		reader._size += block.raw_size;
+		reader._blocks << block;
+	}
+
+	reader._block = std::make_unique<u8[]>(max_raw_size);
+	reader._compressed = std::make_unique<u8[]>(max_stored_size);
+	return core::Ok(std::move(reader));
+}
+
+usize CompressedReader::size() const {
+	return _size;
+}
+
+usize CompressedReader::remaining() const {
+	return _size - _cursor;
+}
+
+bool CompressedReader::at_end() const {
+	return _cursor == _size;
+}
+
+void CompressedReader::seek(usize byte) {
+	_cursor = std::min(_size, byte);
+}
+
+usize CompressedReader::tell() const {
+	return _cursor;
+}
+
+ReadResult CompressedReader::read(void* data, usize bytes) {
+	if(remaining() < bytes) {
+		return core::Err<usize>(0);
+	}
+	const auto r = read_up_to(data, bytes);
+	if(!r || r.unwrap() != bytes) {
+		return core::Err(r ? r.unwrap() : usize(0));
+	}
+	return core::Ok();
+}
+
+ReadUpToResult CompressedReader::read_up_to(void* data, usize max_bytes) {
+	u8* dst = static_cast<u8*>(data);
+	const usize bytes = std::min(max_bytes, remaining());
+
+	usize read = 0;
+	while(read != bytes) {
+		const usize index = block_index(_cursor);
+		if(!load_block(index)) {
+			return core::Err(read);
+		}
+
+		const Block& block = _blocks[index];
+		const usize offset = _cursor - block.raw_offset;
+		const usize count = std::min(bytes - read, block.raw_size - offset);
+		std::memcpy(dst + read, _block.get() + offset, count);
+		read += count;
+		_cursor += count;
+	}
+	return core::Ok(read);
+}
+
+ReadUpToResult CompressedReader::read_all(core::Vector<u8>& data) {
+	const usize size = data.size();
+	const usize left = remaining();
+	data.set_min_capacity(left + size);
+	std::fill_n(std::back_inserter(data), left, 0);
+	return read_up_to(data.begin() + size, left);
+}
+
+bool CompressedReader::load_block(usize index) {
+	if(_loaded == index) {
+		return true;
+	}
+	_loaded = usize(-1);
+
+	const Block& block = _blocks[index];
+	const bool stored_raw = block.stored_size & raw_block_flag;
+	const usize stored_size = block.stored_size & ~raw_block_flag;
+
+	_inner->seek(_base + block.offset);
+	if(stored_raw) {
+		if(stored_size != block.raw_size || !_inner->read(_block.get(), stored_size)) {
+			return false;
+		}
+	} else {
+		if(!_inner->read(_compressed.get(), stored_size) ||
+		   !lz::decompress(_compressed.get(), stored_size, _block.get(), block.raw_size)) {
+			return false;
+		}
+	}
+
+	_loaded = index;
+	return true;
+}
+
+usize CompressedReader::block_index(usize byte) const {
+	y_debug_assert(byte < _size);
+	const auto it = std::upper_bound(_blocks.begin(), _blocks.end(), byte, [](usize b, const Block& block) {
+		return b < block.raw_offset;
+	});
+	y_debug_assert(it != _blocks.begin());
+	return usize(it - _blocks.begin()) - 1;
+}
+
+}
+}
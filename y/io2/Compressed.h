@@ -0,0 +1,137 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_IO2_COMPRESSED_H
+#define Y_IO2_COMPRESSED_H
+
+#include "io.h"
+
+namespace y {
+
+namespace concurrent {
+class StaticThreadPool;
+}
+
+namespace io2 {
+
+// Compressed streams are a sequence of independently compressed blocks followed by their index:
+// [blocks][stored size, raw size of each block][index offset, block count, magic]
+
+// Compresses everything written into another writer
+class CompressedWriter final : public Writer {
+
+	struct Slot {
+		std::unique_ptr<u8[]> data;
+		usize size = 0;
+	};
+
+	public:
+		static constexpr usize min_block_size = 64 * 1024;
+		static constexpr usize max_block_size = 1024 * 1024;
+		static constexpr usize default_block_size = 256 * 1024;
+
+		// With a pool, as many blocks as there are threads are compressed at once
+		CompressedWriter(Writer& inner, usize block_size = default_block_size, concurrent::StaticThreadPool* pool = nullptr);
+		~CompressedWriter() override;
+
+		// Compresses the remaining data and writes the block index, nothing can be written afterward
+		FlushResult finish();
+
+		// Compressed data can not be rewritten, only seeking to the current position is allowed
+		void seek(usize byte) override;
+		usize tell() const override;
+
+		// Ends the current block early
+		FlushResult flush() override;
+		WriteResult write(const void* data, usize bytes) override;
+
+	private:
+		FlushResult compress_pending();
+
+		Writer& _inner;
+		const usize _block_size;
+		concurrent::StaticThreadPool* _pool = nullptr;
+
+		std::unique_ptr<u8[]> _pending;
+		usize _pending_size = 0;
+		usize _pending_capacity = 0;
+		core::Vector<Slot> _slots;
+
+		core::Vector<u64> _index;
+		usize _raw_size = 0;
+		usize _compressed_size = 0;
+		bool _finished = false;
+};
+
+// Reads a compressed stream, from the current position of the inner reader to its end.
+// Seeking only decompresses the block containing the new position.
+class CompressedReader final : public Reader {
+
+	struct Block {
+		usize offset = 0;
+		usize raw_offset = 0;
+		u32 stored_size = 0;
+		u32 raw_size = 0;
+	};
+
+	public:
+		CompressedReader() = default;
+
+		CompressedReader(CompressedReader&& other);
+		CompressedReader& operator=(CompressedReader&& other);
+
+		// The inner reader must outlive the compressed reader
+		static core::Result<CompressedReader> open(Reader& inner);
+
+		usize size() const;
+		usize remaining() const override;
+
+		bool at_end() const override;
+
+		void seek(usize byte) override;
+		usize tell() const override;
+
+		ReadResult read(void* data, usize bytes) override;
+		ReadUpToResult read_up_to(void* data, usize max_bytes) override;
+		ReadUpToResult read_all(core::Vector<u8>& data) override;
+
+	private:
+		void swap(CompressedReader& other);
+
+		bool load_block(usize index);
+		usize block_index(usize byte) const;
+
+		Reader* _inner = nullptr;
+		usize _base = 0;
+		core::Vector<Block> _blocks;
+
+		usize _size = 0;
+		usize _cursor = 0;
+
+		usize _loaded = usize(-1);
+		std::unique_ptr<u8[]> _block;
+		std::unique_ptr<u8[]> _compressed;
+};
+
+}
+}
+
+#endif // Y_IO2_COMPRESSED_H
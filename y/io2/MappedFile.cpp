@@ -0,0 +1,196 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "MappedFile.h"
+
+#include <cstring>
+
+#ifdef Y_OS_WIN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace y {
+namespace io2 {
+
+static void unmap(const u8* data, usize size) {
+	if(!data) {
+		return;
+	}
+#ifdef Y_OS_WIN
+	unused(size);
+	UnmapViewOfFile(data);
+#else
+	munmap(const_cast<u8*>(data), size);
+#endif
+}
+
+// Empty files are open but have no mapping
+static core::Result<std::pair<const u8*, usize>> map(const core::String& name) {
+	using mapping = std::pair<const u8*, usize>;
+#ifdef Y_OS_WIN
+	const HANDLE file = CreateFileA(name.data(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE) {
+		return core::Err();
+	}
+	LARGE_INTEGER size = {};
+	if(!GetFileSizeEx(file, &size)) {
+		CloseHandle(file);
+		return core::Err();
+	}
+	if(!size.QuadPart) {
+		CloseHandle(file);
+		return core::Ok(mapping(nullptr, 0));
+	}
+	const HANDLE map = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if(!map) {
+		return core::Err();
+	}
+	const void* data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(map);
+	if(!data) {
+		return core::Err();
+	}
+	return core::Ok(mapping(static_cast<const u8*>(data), usize(size.QuadPart)));
+#else
+	const int fd = ::open(name.data(), O_RDONLY);
+	if(fd < 0) {
+		return core::Err();
+	}
+	struct stat st = {};
+	if(fstat(fd, &st)) {
+		close(fd);
+		return core::Err();
+	}
+	const usize size = usize(st.st_size);
+	if(!size) {
+		close(fd);
+		return core::Ok(mapping(nullptr, 0));
+	}
+	void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED) {
+		return core::Err();
+	}
+	return core::Ok(mapping(static_cast<const u8*>(data), size));
+#endif
+}
+
+
+MappedFile::~MappedFile() {
+	unmap(_data, _size);
+}
+
+MappedFile::MappedFile(MappedFile&& other) {
+	swap(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) {
+	swap(other);
+	return *this;
+}
+
+void MappedFile::swap(MappedFile& other) {
+	std::swap(_data, other._data);
+	std::swap(_size, other._size);
+	std::swap(_cursor, other._cursor);
+	std::swap(_is_open, other._is_open);
+}
+
+core::Result<MappedFile> MappedFile::open(const core::String& name) {
+	auto mapped = map(name);
+	if(!mapped) {
+		return core::Err();
+	}
+	MappedFile file;
+	file._data = mapped.unwrap().first;
+	file._size = mapped.unwrap().second;
+	file._is_open = true;
+	return core::Ok(std::move(file));
+}
+
+usize MappedFile::size() const {
+	return _size;
+}
+
+usize MappedFile::remaining() const {
+	return _size - _cursor;
+}
+
+bool MappedFile::is_open() const {
+	return _is_open;
+}
+
+bool MappedFile::at_end() const {
+	return _cursor == _size;
+}
+
+void MappedFile::seek(usize byte) {
+	_cursor = std::min(_size, byte);
+}
+
+usize MappedFile::tell() const {
+	return _cursor;
+}
+
+void MappedFile::reset() {
+	seek(0);
+}
+
+ReadResult MappedFile::read(void* data, usize bytes) {
+	if(remaining() < bytes) {
+		return core::Err<usize>(0);
+	}
+	if(bytes) {
+		std::memcpy(data, _data + _cursor, bytes);
+	}
+	_cursor += bytes;
+	return core::Ok();
+}
+
+ReadUpToResult MappedFile::read_up_to(void* data, usize max_bytes) {
+	const usize bytes = std::min(max_bytes, remaining());
+	if(bytes) {
+		std::memcpy(data, _data + _cursor, bytes);
+	}
+	_cursor += bytes;
+	return core::Ok(bytes);
+}
+
+ReadUpToResult MappedFile::read_all(core::Vector<u8>& data) {
+	const usize bytes = remaining();
+	data.push_back(_data + _cursor, _data + _size);
+	_cursor += bytes;
+	return core::Ok(bytes);
+}
+
+const u8* MappedFile::mapped_data() const {
+	return _data;
+}
+
+}
+}
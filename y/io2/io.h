@@ -31,6 +31,7 @@ namespace y {
 namespace io2 {
 
 class File;
+class MappedFile;
 class Buffer;
 
 using ReadUpToResult = core::Result<usize, usize>;
@@ -53,6 +54,11 @@ class Reader : NonCopyable {
 		virtual void seek(usize byte) = 0;
 		virtual usize tell() const = 0;
 
+		// Memory holding the whole content (indexed like seek and tell) if the reader has one, nullptr otherwise
+		virtual const u8* mapped_data() const {
+			return nullptr;
+		}
+
 		template<typename T>
 		ReadResult read_one(T& t) {
 			static_assert(std::is_trivially_copyable_v<T>);
@@ -0,0 +1,205 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "lz.h"
+
+#include <cstring>
+#include <memory>
+
+namespace y {
+namespace io2 {
+namespace lz {
+
+static constexpr usize min_match = 4;
+static constexpr usize max_offset = 0xFFFF;
+static constexpr usize hash_bits = 14;
+
+// Matches never start in the last bytes of a block, so it always ends with literals
+static constexpr usize end_literals = 5;
+static constexpr usize match_limit = 12;
+
+static u32 read_u32(const u8* src) {
+	u32 value = 0;
+	std::memcpy(&value, src, sizeof(value));
+	return value;
+}
+
+static u32 hash(u32 value) {
+	return (value * 2654435761u) >> (32 - hash_bits);
+}
+
+static u8* write_length(u8* dst, usize length) {
+	for(; length >= 255; length -= 255) {
+		*dst++ = 255;
+	}
+	*dst++ = u8(length);
+	return dst;
+}
+
+static u8* write_sequence(u8* dst, const u8* literals, usize literal_count, usize offset, usize match_length) {
+	const usize match_code = match_length ? match_length - min_match : 0;
+	*dst++ = u8((std::min(literal_count, usize(15)) << 4) | std::min(match_code, usize(15)));
+	if(literal_count >= 15) {
+		dst = write_length(dst, literal_count - 15);
+	}
+	if(literal_count) {
+		std::memcpy(dst, literals, literal_count);
+		dst += literal_count;
+	}
+
+	if(match_length) {
+		*dst++ = u8(offset);
+		*dst++ = u8(offset >> 8);
+		if(match_code >= 15) {
+			dst = write_length(dst, match_code - 15);
+		}
+	}
+	return dst;
+}
+
+static bool read_length(const u8*& src, const u8* end, usize& length) {
+	u8 byte = 255;
+	while(byte == 255) {
+		if(src == end) {
+			return false;
+		}
+		byte = *src++;
+		length += byte;
+	}
+	return true;
+}
+
+
+usize compress_bound(usize size) {
+	return size + size / 255 + 16;
+}
+
+usize compress(const u8* src, usize size, u8* dst) {
+	u8* out = dst;
+	usize anchor = 0;
+
+	if(size > match_limit) {
+		// Positions are only hints, candidates are always checked
+		auto table = std::make_unique<u32[]>(usize(1) << hash_bits);
+
+		const usize limit = size - match_limit;
+		usize pos = 1;
+		while(pos < limit) {
+			const u32 value = read_u32(src + pos);
+			u32& entry = table[hash(value)];
+			usize candidate = entry;
+			entry = u32(pos);
+
+			if(candidate >= pos || pos - candidate > max_offset || read_u32(src + candidate) != value) {
+				// Skip faster in incompressible data
+				pos += 1 + ((pos - anchor) >> 6);
+				continue;
+			}
+
+			while(pos > anchor && candidate && src[pos - 1] == src[candidate - 1]) {
+				--pos;
+				--candidate;
+			}
+
+			usize length = min_match;
+			const usize match_end = size - end_literals;
+			while(pos + length < match_end && src[candidate + length] == src[pos + length]) {
+				++length;
+			}
+
+			out = write_sequence(out, src + anchor, pos - anchor, pos - candidate, length);
+			pos += length;
+			anchor = pos;
+
+			if(pos < limit) {
+				table[hash(read_u32(src + pos - 2))] = u32(pos - 2);
+			}
+		}
+	}
+
+	out = write_sequence(out, src + anchor, size - anchor, 0, 0);
+	return usize(out - dst);
+}
+
+bool decompress(const u8* src, usize size, u8* dst, usize dst_size) {
+	const u8* in = src;
+	const u8* in_end = src + size;
+	u8* out = dst;
+	const u8* out_end = dst + dst_size;
+
+	while(in != in_end) {
+		const u8 token = *in++;
+
+		usize literal_count = token >> 4;
+		if(literal_count == 15 && !read_length(in, in_end, literal_count)) {
+			return false;
+		}
+		if(literal_count > usize(in_end - in) || literal_count > usize(out_end - out)) {
+			return false;
+		}
+		if(literal_count) {
+			std::memcpy(out, in, literal_count);
+			in += literal_count;
+			out += literal_count;
+		}
+
+		// The last sequence has no match
+		if(in == in_end) {
+			break;
+		}
+
+		if(in_end - in < 2) {
+			return false;
+		}
+		const usize offset = usize(in[0]) | (usize(in[1]) << 8);
+		in += 2;
+		if(!offset || offset > usize(out - dst)) {
+			return false;
+		}
+
+		usize length = token & 0x0F;
+		if(length == 15 && !read_length(in, in_end, length)) {
+			return false;
+		}
+		length += min_match;
+		if(length > usize(out_end - out)) {
+			return false;
+		}
+
+		const u8* match = out - offset;
+		if(offset >= length) {
+			std::memcpy(out, match, length);
+			out += length;
+		} else {
+			// Overlapping copies repeat the last offset bytes
+			for(usize i = 0; i != length; ++i) {
+				*out++ = match[i];
+			}
+		}
+	}
+
+	return out == out_end;
+}
+
+}
+}
+}
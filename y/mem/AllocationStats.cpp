@@ -0,0 +1,161 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+
+#include "AllocationStats.h"
+
+#include <y/concurrent/concurrent.h>
+#include <y/utils/perf.h>
+
+#include <mutex>
+
+namespace y {
+namespace memory {
+
+static std::mutex& registry_mutex() {
+	static std::mutex mutex;
+	return mutex;
+}
+
+static AllocationStats*& registry_head() {
+	static AllocationStats* head = nullptr;
+	return head;
+}
+
+static usize histogram_index(usize size) {
+	return std::min(log2ui(size), allocation_histogram_size - 1);
+}
+
+static void atomic_max(std::atomic<usize>& value, usize new_value) {
+	usize prev = value.load(std::memory_order_relaxed);
+	while(prev < new_value && !value.compare_exchange_weak(prev, new_value, std::memory_order_relaxed)) {
+		// Nothing
+	}
+}
+
+
+AllocationStats::AllocationStats(const char* tag) : _tag(tag) {
+	const std::unique_lock lock(registry_mutex());
+	AllocationStats*& head = registry_head();
+	_next = head;
+	if(head) {
+		head->_prev = this;
+	}
+	head = this;
+}
+
+AllocationStats::~AllocationStats() {
+	const std::unique_lock lock(registry_mutex());
+	if(_prev) {
+		_prev->_next = _next;
+	} else {
+		registry_head() = _next;
+	}
+	if(_next) {
+		_next->_prev = _prev;
+	}
+}
+
+const char* AllocationStats::tag() const {
+	return _tag;
+}
+
+AllocationStats::Slot& AllocationStats::thread_slot() {
+	return _slots[concurrent::thread_id() % slot_count];
+}
+
+void AllocationStats::on_allocate(usize size) {
+	Slot& slot = thread_slot();
+	slot.allocation_count.fetch_add(1, std::memory_order_relaxed);
+	slot.total_bytes.fetch_add(size, std::memory_order_relaxed);
+	slot.histogram[histogram_index(size)].fetch_add(1, std::memory_order_relaxed);
+
+	const usize current = _current.fetch_add(size, std::memory_order_relaxed) + size;
+	atomic_max(_peak, current);
+}
+
+void AllocationStats::on_deallocate(usize size) {
+	thread_slot().deallocation_count.fetch_add(1, std::memory_order_relaxed);
+	_current.fetch_sub(size, std::memory_order_relaxed);
+}
+
+AllocationSnapshot AllocationStats::snapshot() const {
+	AllocationSnapshot snap;
+	snap.tag = _tag;
+	snap.current_bytes = _current.load(std::memory_order_relaxed);
+	snap.peak_bytes = _peak.load(std::memory_order_relaxed);
+	for(const Slot& slot : _slots) {
+		snap.allocation_count += slot.allocation_count.load(std::memory_order_relaxed);
+		snap.deallocation_count += slot.deallocation_count.load(std::memory_order_relaxed);
+		snap.total_bytes += slot.total_bytes.load(std::memory_order_relaxed);
+		for(usize i = 0; i != allocation_histogram_size; ++i) {
+			snap.histogram[i] += slot.histogram[i].load(std::memory_order_relaxed);
+		}
+	}
+	return snap;
+}
+
+core::Vector<AllocationSnapshot> AllocationStats::snapshot_all() {
+	core::Vector<AllocationSnapshot> snapshots;
+	const std::unique_lock lock(registry_mutex());
+	for(const AllocationStats* stats = registry_head(); stats; stats = stats->_next) {
+		snapshots << stats->snapshot();
+	}
+	return snapshots;
+}
+
+void AllocationStats::dump_to_perf() {
+	static constexpr std::array<const char*, allocation_histogram_size> bucket_names = {
+		"1B", "2B", "4B", "8B", "16B", "32B", "64B", "128B",
+		"256B", "512B", "1KB", "2KB", "4KB", "8KB", "16KB", "32KB",
+		"64KB", "128KB", "256KB", "512KB", "1MB", "2MB", "4MB", "8MB+"
+	};
+
+	if(!perf::is_capturing()) {
+		return;
+	}
+
+	for(const AllocationSnapshot& snap : snapshot_all()) {
+		const perf::CounterValue bytes[] = {
+			{"current", snap.current_bytes},
+			{"peak", snap.peak_bytes},
+			{"total", snap.total_bytes},
+			{"allocations", snap.allocation_count},
+			{"deallocations", snap.deallocation_count},
+		};
+		perf::counter("memory", snap.tag, bytes);
+
+		std::array<perf::CounterValue, allocation_histogram_size> histogram;
+		for(usize i = 0; i != allocation_histogram_size; ++i) {
+			histogram[i] = {bucket_names[i], snap.histogram[i]};
+		}
+		perf::counter("memory histogram", snap.tag, histogram);
+	}
+}
+
+
+AllocationStats* default_allocation_stats() {
+	static AllocationStats stats;
+	return &stats;
+}
+
+}
+}
@@ -0,0 +1,98 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_MEM_ALLOCATIONSTATS_H
+#define Y_MEM_ALLOCATIONSTATS_H
+
+#include <y/utils.h>
+#include <y/core/Vector.h>
+
+#include <atomic>
+#include <array>
+
+namespace y {
+namespace memory {
+
+// Bucket i counts allocations with size in [2^i, 2^(i+1)), last bucket catches everything bigger
+static constexpr usize allocation_histogram_size = 24;
+
+struct AllocationSnapshot {
+	const char* tag = nullptr;
+
+	usize current_bytes = 0;
+	usize peak_bytes = 0;
+	usize total_bytes = 0;
+
+	usize allocation_count = 0;
+	usize deallocation_count = 0;
+
+	std::array<usize, allocation_histogram_size> histogram = {};
+};
+
+// Counters are spread across per-thread slots so allocating threads don't fight over the same cache line.
+// Current and peak bytes need a consistent global view and are tracked with a shared atomic.
+class AllocationStats : NonMovable {
+	static constexpr usize slot_count = 16;
+
+	struct alignas(64) Slot {
+		std::atomic<usize> allocation_count = 0;
+		std::atomic<usize> deallocation_count = 0;
+		std::atomic<usize> total_bytes = 0;
+		std::array<std::atomic<usize>, allocation_histogram_size> histogram = {};
+	};
+
+	public:
+		// Tag must have static storage
+		AllocationStats(const char* tag = "untagged");
+		~AllocationStats();
+
+		const char* tag() const;
+
+		void on_allocate(usize size);
+		void on_deallocate(usize size);
+
+		AllocationSnapshot snapshot() const;
+
+		static core::Vector<AllocationSnapshot> snapshot_all();
+
+		// Writes all registered stats as counter events in the current perf capture
+		static void dump_to_perf();
+
+	private:
+		Slot& thread_slot();
+
+		const char* _tag = nullptr;
+
+		std::array<Slot, slot_count> _slots;
+
+		std::atomic<usize> _current = 0;
+		std::atomic<usize> _peak = 0;
+
+		AllocationStats* _next = nullptr;
+		AllocationStats* _prev = nullptr;
+};
+
+AllocationStats* default_allocation_stats();
+
+}
+}
+
+#endif // Y_MEM_ALLOCATIONSTATS_H
@@ -23,10 +23,14 @@ SOFTWARE.
 #define Y_MEM_ALLOCATORS_H
 
 #include "memory.h"
+#include "AllocationStats.h"
 
+#include <y/core/Vector.h>
 #include <y/utils/format.h>
 
 #include <algorithm>
+#include <memory>
+#include <array>
 #include <mutex>
 
 namespace y {
@@ -135,6 +139,147 @@ class ThreadSafeAllocator : NonCopyable {
 		std::mutex _lock;
 };
 
+// Keeps a per-thread magazine of free blocks for each small size class.
+// Magazines are refilled from and drained to the wrapped allocator in batches, under a single lock.
+// Blocks cached by a thread are returned when that thread exits, so the wrapped allocator is kept alive until then.
+template<typename Allocator, usize MaxSize = 512, usize MagazineSize = 64>
+class MagazineAllocator : NonCopyable {
+	static_assert(MagazineSize >= 2);
+
+	static constexpr usize class_count = align_up_to_max(MaxSize) / max_alignment;
+	static constexpr usize batch_size = MagazineSize / 2;
+
+	struct Shared : NonMovable {
+		Shared() = default;
+		Shared(Allocator&& a) : allocator(std::move(a)) {
+		}
+
+		Allocator allocator;
+		std::mutex lock;
+	};
+
+	struct Magazine {
+		std::array<void*, MagazineSize> blocks;
+		usize count = 0;
+	};
+
+	struct ThreadCache : NonMovable {
+		ThreadCache(std::shared_ptr<Shared> sh) : shared(std::move(sh)) {
+		}
+
+		~ThreadCache() {
+			const std::unique_lock lock(shared->lock);
+			for(usize c = 0; c != class_count; ++c) {
+				Magazine& mag = magazines[c];
+				for(usize i = 0; i != mag.count; ++i) {
+					shared->allocator.deallocate(mag.blocks[i], class_size(c));
+				}
+			}
+		}
+
+		std::shared_ptr<Shared> shared;
+		std::array<Magazine, class_count> magazines;
+	};
+
+	public:
+		static constexpr usize max_cached_size = class_count * max_alignment;
+
+		MagazineAllocator() : _shared(std::make_shared<Shared>()) {
+		}
+
+		MagazineAllocator(Allocator&& a) : _shared(std::make_shared<Shared>(std::move(a))) {
+		}
+
+		[[nodiscard]] void* allocate(usize size) noexcept {
+			if(size > max_cached_size) {
+				const std::unique_lock lock(_shared->lock);
+				return _shared->allocator.allocate(size);
+			}
+
+			const usize c = size_class(size);
+			Magazine& mag = thread_cache().magazines[c];
+			if(!mag.count) {
+				refill(mag, c);
+				if(!mag.count) {
+					return nullptr;
+				}
+			}
+			return mag.blocks[--mag.count];
+		}
+
+		void deallocate(void* ptr, usize size) noexcept {
+			if(size > max_cached_size) {
+				const std::unique_lock lock(_shared->lock);
+				_shared->allocator.deallocate(ptr, size);
+				return;
+			}
+
+			if(!ptr) {
+				return;
+			}
+
+			const usize c = size_class(size);
+			Magazine& mag = thread_cache().magazines[c];
+			if(mag.count == MagazineSize) {
+				drain(mag, c);
+			}
+			mag.blocks[mag.count++] = ptr;
+		}
+
+	private:
+		static constexpr usize size_class(usize size) {
+			return align_up_to_max(std::max(size, usize(1))) / max_alignment - 1;
+		}
+
+		static constexpr usize class_size(usize c) {
+			return (c + 1) * max_alignment;
+		}
+
+		void refill(Magazine& mag, usize c) {
+			y_debug_assert(!mag.count);
+			const std::unique_lock lock(_shared->lock);
+			for(; mag.count != batch_size; ++mag.count) {
+				void* ptr = _shared->allocator.allocate(class_size(c));
+				if(!ptr) {
+					break;
+				}
+				mag.blocks[mag.count] = ptr;
+			}
+		}
+
+		void drain(Magazine& mag, usize c) {
+			y_debug_assert(mag.count >= batch_size);
+			const std::unique_lock lock(_shared->lock);
+			for(usize i = 0; i != batch_size; ++i) {
+				_shared->allocator.deallocate(mag.blocks[--mag.count], class_size(c));
+			}
+		}
+
+		ThreadCache& thread_cache() {
+			static thread_local core::Vector<std::unique_ptr<ThreadCache>> caches;
+			static thread_local ThreadCache* last = nullptr;
+
+			if(last && last->shared == _shared) {
+				return *last;
+			}
+			last = nullptr;
+			for(usize i = 0; i < caches.size(); ++i) {
+				if(caches[i]->shared == _shared) {
+					last = caches[i].get();
+				} else if(caches[i]->shared.use_count() == 1) {
+					// The allocator is gone, give everything back
+					caches.erase_unordered(caches.begin() + i--);
+				}
+			}
+			if(last) {
+				return *last;
+			}
+			return *(last = caches.emplace_back(std::make_unique<ThreadCache>(_shared)).get());
+		}
+
+		std::shared_ptr<Shared> _shared;
+};
+
 template<usize Threshold, typename Small, typename Large>
 class SegregatorAllocator : NonCopyable {
 	public:
@@ -242,6 +387,42 @@ class LeakDetectorAllocator : NonCopyable {
 		usize _alive = 0;
 };
 
+template<typename Allocator>
+class ProfilingAllocator : NonCopyable {
+	public:
+		ProfilingAllocator() = default;
+
+		// does NOT take ownership of stats
+		ProfilingAllocator(NotOwner<AllocationStats*> stats) : _stats(stats) {
+		}
+
+		ProfilingAllocator(NotOwner<AllocationStats*> stats, Allocator&& a) : _allocator(std::move(a)), _stats(stats) {
+		}
+
+		[[nodiscard]] void* allocate(usize size) noexcept {
+			void* ptr = _allocator.allocate(size);
+			if(ptr) {
+				_stats->on_allocate(size);
+			}
+			return ptr;
+		}
+
+		void deallocate(void* ptr, usize size) noexcept {
+			if(ptr) {
+				_stats->on_deallocate(size);
+			}
+			_allocator.deallocate(ptr, size);
+		}
+
+		const AllocationStats& stats() const {
+			return *_stats;
+		}
+
+	private:
+		Allocator _allocator;
+		NotOwner<AllocationStats*> _stats = default_allocation_stats();
+};
+
 
 
 }
@@ -23,24 +23,28 @@ SOFTWARE.
 #define Y_SERDE3_ARCHIVES_H
 
 #include <memory>
+#include <cstring>
+#include <array>
+#include <optional>
 
 #include <y/core/Range.h>
 #include <y/core/Vector.h>
+#include <y/core/HashMap.h>
 
 #include "headers.h"
 #include "conversions.h"
+#include "compact.h"
 #include "property.h"
 
 #include <y/io2/io.h>
+#include <y/io2/Buffer.h>
+
+#include <y/concurrent/StaticThreadPool.h>
 
 #include <y/utils/log.h>
 
 #define Y_SERDE3_BUFFER
 
-#ifdef Y_SERDE3_BUFFER
-#include <y/io2/Buffer.h>
-#endif
-
 #define y_try_status(result)																	\
 	do {																						\
 		if(auto&& _y_try_result = (result); _y_try_result.is_error()) { 						\
@@ -54,6 +58,9 @@ SOFTWARE.
 namespace y {
 namespace serde3 {
 
+template<typename T>
+class Lazy;
+
 namespace detail {
 
 using size_type = u64;
@@ -89,6 +96,28 @@ struct IsRange<core::Range<I, E>> {
 };
 
 
+template<typename T>
+struct IsLazy {
+	static constexpr bool value = false;
+};
+
+template<typename T>
+struct IsLazy<Lazy<T>> {
+	static constexpr bool value = true;
+};
+
+
+template<typename T>
+struct IsConstSpan {
+	static constexpr bool value = false;
+};
+
+template<typename T>
+struct IsConstSpan<core::MutableSpan<const T>> {
+	static constexpr bool value = true;
+};
+
+
 template<typename T>
 struct IsTuple {
 	static constexpr bool value = false;
@@ -140,12 +169,91 @@ struct IsArray<std::array<T, N>> {
 
 template<typename T, typename value_type = remove_cvref_t<typename T::value_type>>
 constexpr bool use_collection_fast_path =
-		(has_resize_v<T> || has_emplace_back_v<T>) &&
+		(has_resize_v<T> || has_emplace_back_v<T> || IsRange<T>::value) &&
 		std::is_pointer_v<decltype(std::declval<T>().begin())> &&
 		std::is_trivially_copyable_v<value_type> &&
 		!has_serde3_v<value_type> &&
 		!std::is_pointer_v<value_type>;
 
+// Lazy values and mapped spans keep a pointer to the reader they were read from, so they can't be read from a copy.
+// Types nested too deeply are assumed to borrow, poly objects can only be checked by the ReadableArchive.
+template<typename T, usize Depth = 8>
+constexpr bool borrows_reader();
+
+template<usize Depth, typename T>
+struct BorrowsReaderAny {
+	static constexpr bool value = false;
+};
+
+template<usize Depth, template<typename...> typename Tpl, typename... Args>
+struct BorrowsReaderAny<Depth, Tpl<Args...>> {
+	static constexpr bool value = (borrows_reader<Args, Depth>() || ...);
+};
+
+template<usize Depth, typename... Args, bool... Refs>
+struct BorrowsReaderAny<Depth, std::tuple<NamedObject<Args, Refs>...>> {
+	static constexpr bool value = (borrows_reader<Args, Depth>() || ...);
+};
+
+template<typename T, usize Depth>
+constexpr bool borrows_reader() {
+	using type = remove_cvref_t<T>;
+	if constexpr(!Depth) {
+		return true;
+	} else if constexpr(IsLazy<type>::value || IsConstSpan<type>::value) {
+		return true;
+	} else if constexpr(has_serde3_v<type>) {
+		return BorrowsReaderAny<Depth - 1, decltype(members(std::declval<type&>()))>::value;
+	} else if constexpr(IsProperty<type>::value) {
+		return borrows_reader<typename type::value_type, Depth - 1>();
+	} else if constexpr(IsTuple<type>::value) {
+		return BorrowsReaderAny<Depth - 1, type>::value;
+	} else if constexpr(StdPtr<type>::is_std_ptr) {
+		return borrows_reader<typename type::element_type, Depth - 1>();
+	} else if constexpr(is_iterable_v<type>) {
+		return borrows_reader<decltype(*std::declval<type&>().begin()), Depth - 1>();
+	} else {
+		return false;
+	}
+}
+
+// Segmented collections are split in independently framed segments, that can be written and read concurrently
+template<typename T>
+constexpr bool use_collection_segments =
+		!use_collection_fast_path<T> &&
+		has_size_v<T> &&
+		std::is_pointer_v<decltype(std::declval<T>().begin())> &&
+		!borrows_reader<typename T::value_type>();
+
+// Set in the item count of segmented collections
+static constexpr size_type segmented_flag = size_type(1) << 63;
+
+static constexpr usize default_segment_size = 4096;
+
+struct Segment {
+	io2::Buffer buffer;
+	bool ok = false;
+	bool borrowed = false;
+};
+
+// Table of contents entries locate objects relatively to the start of the root object.
+// Keys combine the hashes of the path components: member names or collection indices.
+struct TocEntry {
+	u64 key = 0;
+	u64 offset = 0;
+};
+
+inline u64 toc_name_key(u64 parent, std::string_view name) {
+	hash_combine(parent, u64(ct_str_hash(name)));
+	return parent;
+}
+
+inline u64 toc_index_key(u64 parent, usize index) {
+	// Name hashes are 32 bits, so indices can't collide with them
+	hash_combine(parent, u64(index) | (u64(1) << 63));
+	return parent;
+}
+
 template<typename T>
 static constexpr bool is_pod_base_v = std::is_trivially_copyable_v<remove_cvref_t<T>> && std::is_trivially_copy_constructible_v<remove_cvref_t<T>>;
 
@@ -166,6 +274,12 @@ static constexpr bool is_property_v = detail::IsProperty<remove_cvref_t<T>>::val
 template<typename T>
 static constexpr bool is_range_v = detail::IsRange<remove_cvref_t<T>>::value;
 
+template<typename T>
+static constexpr bool is_const_span_v = detail::IsConstSpan<remove_cvref_t<T>>::value;
+
+template<typename T>
+static constexpr bool is_lazy_v = detail::IsLazy<remove_cvref_t<T>>::value;
+
 template<typename T>
 static constexpr bool is_tuple_v = detail::IsTuple<remove_cvref_t<T>>::value;
 
@@ -189,6 +303,14 @@ auto make_std_ptr() {
 
 
 
+// Patch writes size placeholders and seeks back to fill them.
+// Stream never seeks, so that any append only writer can be used: sizes are computed by a first
+// pass that writes nothing, which roughly doubles the CPU cost of serialization.
+enum class WriteMode {
+	Patch,
+	Stream
+};
+
 class WritableArchive final {
 
 	//using File = io2::WriterPtr;
@@ -201,20 +323,28 @@ class WritableArchive final {
 	static constexpr usize buffer_size = 64 * 1024;
 
 	struct SizePatch {
+		// Position of the size
 		usize index = 0;
+		// Position of the first byte counted in size
+		usize start = 0;
 		detail::size_type size = 0;
+		// Index in _stream_sizes
+		usize slot = 0;
 	};
 
 	public:
-		WritableArchive(File& file) :
+		// The compact encoding always uses WriteMode::Stream
+		WritableArchive(File& file, WriteMode mode = WriteMode::Patch, Encoding encoding = Encoding::Fixed) :
 				_file(file),
+				_mode(encoding == Encoding::Compact ? WriteMode::Stream : mode),
+				_encoding(encoding),
 #ifdef Y_SERDE3_BUFFER
 				_buffer(buffer_size),
 #endif
-				_cached_file_size(_file.tell())
+				_cached_file_size(_mode == WriteMode::Stream ? 0 : _file.tell())
 		{}
 
-		WritableArchive(std::unique_ptr<File> file) : WritableArchive(*file) {
+		WritableArchive(std::unique_ptr<File> file, WriteMode mode = WriteMode::Patch, Encoding encoding = Encoding::Fixed) : WritableArchive(*file, mode, encoding) {
 			_storage = std::move(file);
 		}
 
@@ -225,13 +355,87 @@ class WritableArchive final {
 			y_debug_assert(_patches.is_empty());
 		}
 
+		// Collections of more than segment_size non POD items are serialized in segments on the pool.
+		// Only used with WriteMode::Patch and the fixed encoding.
+		void set_thread_pool(concurrent::StaticThreadPool* pool, usize segment_size = detail::default_segment_size) {
+			y_debug_assert(segment_size);
+			_thread_pool = pool;
+			_segment_size = segment_size;
+		}
+
+		// Roots are followed by a table of contents locating the objects up to depth levels below them
+		// (1 for the members of the root), which ReadableArchive::deserialize_entry uses to only read one object.
+		// Items of collections written as raw arrays (trivially copyable items) are not in the table,
+		// only the whole collection can be read, in a single block.
+		// Archives with a table of contents must be read with ReadableArchive::set_table_of_contents.
+		void set_table_of_contents(usize depth) {
+			_toc_depth = depth;
+		}
+
 		template<typename T>
 		Result serialize(const T& t) {
-			y_try(serialize_one(NamedObject{t, detail::version_string}));
-			return finalize();
+			if(_depth) {
+				// Polymorphic objects serialize themselves through here
+				return serialize_one(NamedObject{t, detail::version_string});
+			}
+
+			++_depth;
+			Result result = serialize_root(t);
+			--_depth;
+			if(!result) {
+				// Patches of the failed object are still applied so the archive can be destroyed or reused
+				unused(finalize());
+			}
+			return result;
 		}
 
 	private:
+		template<typename T>
+		Result serialize_root(const T& t) {
+			if(_mode == WriteMode::Stream) {
+				y_try(measure(t));
+			}
+			if(_encoding == Encoding::Compact) {
+				y_try(write_header_table());
+			}
+			y_try(serialize_root_object(t));
+			if(_toc_depth) {
+				y_try(write_table_of_contents());
+			}
+			return finalize();
+		}
+
+		// With a table of contents the root is prefixed by its size, so that the table can be found
+		template<typename T>
+		Result serialize_root_object(const T& t) {
+			if(!_toc_depth) {
+				return serialize_one(NamedObject{t, detail::version_string});
+			}
+
+			_toc.make_empty();
+			_toc_key = 0;
+
+			SizePatch patch;
+			y_try(begin_patch(patch));
+			_toc_start = patch.start;
+			y_try(serialize_one(NamedObject{t, detail::version_string}));
+			return end_patch(patch, written_since(patch));
+		}
+
+		// Dry pass that only records the sizes, in the order the patches are created, and the headers
+		template<typename T>
+		Result measure(const T& t) {
+			_measuring = true;
+			_measured_size = 0;
+			_stream_sizes.make_empty();
+			_stream_cursor = 0;
+			_headers.make_empty();
+			_header_indexes.make_empty();
+			Result result = serialize_root_object(t);
+			_measuring = false;
+			return result;
+		}
+
 		Result flush() {
 			y_try(finalize_in_buffer());
 #ifdef Y_SERDE3_BUFFER
@@ -239,14 +443,14 @@ class WritableArchive final {
 			if(buffer_size) {
 				y_try_discard(_file.write(_buffer.data(), buffer_size));
 				_buffer.clear();
+				_cached_file_size += buffer_size;
 			}
-			_cached_file_size = _file.tell();
 #endif
 			return core::Ok(Success::Full);
 		}
 
 		Result finalize_in_buffer() {
-			y_debug_assert(_cached_file_size == _file.tell());
+			y_debug_assert(_mode == WriteMode::Stream || _cached_file_size == _file.tell());
 #ifdef Y_SERDE3_BUFFER
 			while(!_patches.is_empty()) {
 				const auto& p = _patches.last();
@@ -264,6 +468,11 @@ class WritableArchive final {
 
 		Result finalize() {
 			y_try(flush());
+			if(_patches.is_empty()) {
+				return core::Ok(Success::Full);
+			}
+
+			y_debug_assert(_mode == WriteMode::Patch);
 			usize pos = _file.tell();
 			for(const SizePatch& patch : _patches) {
 				_file.seek(patch.index);
@@ -283,7 +492,7 @@ class WritableArchive final {
 				return serialize_property(object);
 			} else {
 				const auto header = detail::build_header(object);
-				y_try(write_one(header));
+				y_try(write_header(header));
 
 				if constexpr(has_serde3_poly_v<T>) {
 					return serialize_poly(object);
@@ -293,6 +502,8 @@ class WritableArchive final {
 					return serialize_tuple(object);
 				} else if constexpr(is_range_v<T>) {
 					return serialize_range(object);
+				} else if constexpr(is_lazy_v<T>) {
+					return serialize_lazy(object);
 				} else if constexpr(is_pod_v<T>) {
 					return serialize_pod(object);
 				} else if constexpr(is_std_ptr_v<T>) {
@@ -318,18 +529,17 @@ class WritableArchive final {
 			static_assert(std::is_const_v<T>);
 
 			if(object.object == nullptr) {
-				return write_one(size_type(0));
+				return write_size(0);
 			}
 
-			SizePatch patch{tell(), 0};
+			SizePatch patch;
 
 			{
-				y_try(write_one(size_type(-1)));
+				y_try(begin_patch(patch));
 				y_try(serialize_one(NamedObject{*object.object, detail::ptr_version_string}));
 			}
 
-			patch.size = (size_type(tell()) - size_type(patch.index)) - sizeof(size_type);
-			push_patch(patch);
+			y_try(end_patch(patch, written_since(patch)));
 
 			return core::Ok(Success::Full);
 		}
@@ -346,36 +556,99 @@ class WritableArchive final {
 			static_assert(std::is_const_v<T>);
 			static_assert(is_iterable_v<T>);
 
-			SizePatch patch{tell(), 0};
+			SizePatch patch;
 
 			{
-				y_try(write_one(size_type(-1)));
+				y_try(begin_patch(patch));
 
 				if constexpr(detail::use_collection_fast_path<remove_cvref_t<T>>) {
-					y_try(write_one(size_type(object.object.size())));
+					// Raw array items have no header and are not in the table of contents
+					y_try(write_size(object.object.size()));
 					if(object.object.size()) {
 						const auto header = detail::build_header(NamedObject{*object.object.begin(), detail::collection_version_string});
-						y_try(write_one(header));
+						y_try(write_header(header));
 						y_try(write_array(object.object.begin(), object.object.size()));
 					}
+				} else if(use_segments(object.object)) {
+					y_try(serialize_segments(object.object));
 				} else {
 					// Size is patched so we don't have to call .size() on funky objects (like ranges)
-					SizePatch size_patch{tell(), 0};
-					y_try(write_one(size_type(0)));
+					SizePatch size_patch;
+					y_try(begin_patch(size_patch));
+					size_type item_count = 0;
 					for(const auto& item : object.object) {
-						y_try(serialize_one(NamedObject{item, detail::collection_version_string}));
-						++size_patch.size;
+						y_try(serialize_entry(NamedObject{item, detail::collection_version_string}, detail::toc_index_key(_toc_key, item_count)));
+						++item_count;
 					}
-					push_patch(size_patch);
+					y_try(end_patch(size_patch, item_count));
 				}
 			}
 
-			patch.size = (size_type(tell()) - size_type(patch.index)) - sizeof(size_type);
-			push_patch(patch);
+			y_try(end_patch(patch, written_since(patch)));
 
 			return core::Ok(Success::Full);
 		}
 
+		template<typename T>
+		bool use_segments(const T& collection) const {
+			if constexpr(detail::use_collection_segments<remove_cvref_t<T>>) {
+				// Segmented items are not in the table of contents
+				return _thread_pool &&
+					   _mode == WriteMode::Patch &&
+					   _encoding == Encoding::Fixed &&
+					   _toc_level >= _toc_depth &&
+					   collection.size() > _segment_size;
+			} else {
+				unused(collection);
+				return false;
+			}
+		}
+
+		// [item count | segmented_flag][segment size][byte size of each segment][segments]
+		template<typename T>
+		Result serialize_segments(const T& collection) {
+			if constexpr(detail::use_collection_segments<remove_cvref_t<T>>) {
+				const usize size = collection.size();
+				const usize segment_size = _segment_size;
+				const usize segment_count = (size + segment_size - 1) / segment_size;
+				const auto* items = collection.begin();
+
+				auto segments = std::make_unique<detail::Segment[]>(segment_count);
+				concurrent::DependencyGroup group;
+				for(usize s = 0; s != segment_count; ++s) {
+					_thread_pool->schedule([&segments, items, size, segment_size, s] {
+						WritableArchive arc(segments[s].buffer);
+						++arc._depth;
+						bool ok = true;
+						const usize end = std::min(size, (s + 1) * segment_size);
+						for(usize i = s * segment_size; i != end && ok; ++i) {
+							ok = arc.serialize_one(NamedObject{items[i], detail::collection_version_string}).is_ok();
+						}
+						// Always finalized so that no patch is left pending, the buffer is dropped on failure
+						const bool finalized = arc.finalize().is_ok();
+						segments[s].ok = ok && finalized;
+					}, &group);
+				}
+				_thread_pool->wait_for(group);
+
+				y_try(write_size(size_type(size) | detail::segmented_flag));
+				y_try(write_size(segment_size));
+				for(usize s = 0; s != segment_count; ++s) {
+					if(!segments[s].ok) {
+						return core::Err();
+					}
+					y_try(write_size(segments[s].buffer.size()));
+				}
+				for(usize s = 0; s != segment_count; ++s) {
+					y_try(write_array(segments[s].buffer.data(), segments[s].buffer.size()));
+				}
+				return core::Ok(Success::Full);
+			} else {
+				unused(collection);
+				return core::Err();
+			}
+		}
+
 
 		// ------------------------------- POLY -------------------------------
 		template<typename T>
@@ -384,23 +657,21 @@ class WritableArchive final {
 			static_assert(!has_serde3_v<T>);
 
 			if(object.object == nullptr) {
-				return write_one(size_type(0));
+				return write_size(0);
 			}
 
-			SizePatch patch{tell(), 0};
+			SizePatch patch;
 
 			{
-				y_try(write_one(size_type(-1)));
+				y_try(begin_patch(patch));
 				y_try(object.object->_y_serde3_poly_serialize(*this));
 			}
 
-			patch.size = (size_type(tell()) - size_type(patch.index)) - sizeof(size_type);
 			// make sure size isn't 0 for non null
-			if(!patch.size) {
+			if(!written_since(patch)) {
 				y_try(write_one(u8(0)));
-				++patch.size;
 			}
-			push_patch(patch);
+			y_try(end_patch(patch, written_since(patch)));
 
 			return core::Ok(Success::Full);
 		}
@@ -413,7 +684,14 @@ class WritableArchive final {
 			static_assert(is_pod_v<T>);
 			static_assert(!std::is_pointer_v<T>);
 
-			y_try(write_one(size_type(sizeof(T))));
+			if constexpr(detail::is_packed_integer_v<remove_cvref_t<T>>) {
+				if(_encoding == Encoding::Compact) {
+					// Integers are self delimited, no size needed
+					return write_varint(detail::pack_integer(object.object));
+				}
+			}
+
+			y_try(write_size(sizeof(T)));
 			return write_one(object.object);
 		}
 
@@ -424,15 +702,14 @@ class WritableArchive final {
 			static_assert(std::is_const_v<T>);
 			static_assert(!has_serde3_poly_v<T>);
 
-			SizePatch patch{tell(), 0};
+			SizePatch patch;
 
 			{
-				y_try(write_one(size_type(-1)));
+				y_try(begin_patch(patch));
 				y_try(serialize_members(object.object));
 			}
 
-			patch.size = (size_type(tell()) - size_type(patch.index)) - sizeof(size_type);
-			push_patch(patch);
+			y_try(end_patch(patch, written_since(patch)));
 
 			return core::Ok(Success::Full);
 		}
@@ -441,7 +718,7 @@ class WritableArchive final {
 		Result serialize_members_internal(const std::tuple<NamedObject<Args, Refs>...>& objects) {
 			unused(objects);
 			if constexpr(I < sizeof...(Args)) {
-				y_try(serialize_one(std::get<I>(objects)));
+				y_try(serialize_entry(std::get<I>(objects), detail::toc_name_key(_toc_key, std::get<I>(objects).name)));
 				y_try(serialize_members_internal<I + 1>(objects));
 			}
 			return core::Ok(Success::Full);
@@ -453,20 +730,67 @@ class WritableArchive final {
 		}
 
 
+		// ------------------------------- LAZY -------------------------------
+		// The value is written as a complete archive so that it can be read on its own
+		template<typename T>
+		Result serialize_lazy(NamedObject<T> object) {
+			static_assert(std::is_const_v<T>);
+
+			y_try(object.object.load());
+
+			io2::Buffer buffer;
+			{
+				WritableArchive arc(buffer, WriteMode::Patch, _encoding);
+				y_try(arc.serialize(object.object.get()));
+			}
+
+			y_try(write_size(buffer.size()));
+			return write_array(buffer.data(), buffer.size());
+		}
+
+
+		// ------------------------------- TOC -------------------------------
+		template<typename T, bool R>
+		Result serialize_entry(const NamedObject<T, R>& object, u64 key) {
+			if(_toc_level >= _toc_depth) {
+				return serialize_one(object);
+			}
+
+			if(!_measuring) {
+				_toc << detail::TocEntry{key, tell() - _toc_start};
+			}
+
+			const u64 parent_key = _toc_key;
+			_toc_key = key;
+			++_toc_level;
+			Result result = serialize_one(object);
+			--_toc_level;
+			_toc_key = parent_key;
+			return result;
+		}
+
+		Result write_table_of_contents() {
+			y_try(write_size(_toc.size()));
+			for(const detail::TocEntry& entry : _toc) {
+				y_try(write_one(entry));
+			}
+			return core::Ok(Success::Full);
+		}
+
+
 		// ------------------------------- TUPLE -------------------------------
 		template<typename T>
 		Result serialize_tuple(NamedObject<T> object) {
 			static_assert(std::is_const_v<T>);
 
-			SizePatch patch{tell(), 0};
+			SizePatch patch;
 
 			{
-				y_try(write_one(size_type(-1)));
+				y_try(begin_patch(patch));
 				y_try(serialize_tuple_members<0>(object.object));
 			}
 
-			patch.size = (size_type(tell()) - size_type(patch.index)) - sizeof(size_type);
-			push_patch(patch);
+			y_try(end_patch(patch, written_since(patch)));
 
 			return core::Ok(Success::Full);
 		}
@@ -485,6 +809,10 @@ class WritableArchive final {
 		// ------------------------------- WRITE -------------------------------
 		template<typename T>
 		Result write_one(const T& t) {
+			if(_measuring) {
+				_measured_size += sizeof(T);
+				return core::Ok(Success::Full);
+			}
 #ifdef Y_SERDE3_BUFFER
 			if(_buffer.size() + sizeof(T) > buffer_size) {
 				y_try(flush());
@@ -499,6 +827,10 @@ class WritableArchive final {
 
 		template<typename T>
 		Result write_array(const T* t, usize size) {
+			if(_measuring) {
+				_measured_size += sizeof(T) * size;
+				return core::Ok(Success::Full);
+			}
 #ifdef Y_SERDE3_BUFFER
 			if(_buffer.size() + (sizeof(T) * size) > buffer_size) {
 				y_try(flush());
@@ -512,6 +844,9 @@ class WritableArchive final {
 		}
 
 		usize tell() const {
+			if(_measuring) {
+				return _measured_size;
+			}
 #ifdef Y_SERDE3_BUFFER
 			return _cached_file_size + _buffer.tell();
 #else
@@ -519,6 +854,114 @@ class WritableArchive final {
 #endif
 		}
 
+		// Writes a size placeholder, or the measured size in stream mode
+		Result begin_patch(SizePatch& patch) {
+			patch.index = tell();
+			if(_measuring) {
+				patch.slot = _stream_sizes.size();
+				_stream_sizes << size_type(-1);
+				// Varint sizes are counted once known, in end_patch
+				if(_encoding == Encoding::Fixed) {
+					y_try(write_one(size_type(-1)));
+				}
+			} else if(_mode == WriteMode::Stream) {
+				y_debug_assert(_stream_cursor < _stream_sizes.size());
+				patch.slot = _stream_cursor++;
+				y_try(write_size(_stream_sizes[patch.slot]));
+			} else {
+				y_try(write_one(size_type(-1)));
+			}
+			patch.start = tell();
+			return core::Ok(Success::Full);
+		}
+
+		Result end_patch(SizePatch& patch, size_type size) {
+			patch.size = size;
+			if(_measuring) {
+				_stream_sizes[patch.slot] = size;
+				if(_encoding == Encoding::Compact) {
+					_measured_size += detail::varint_size(size);
+				}
+			} else if(_mode == WriteMode::Stream) {
+				// The object changed between the two passes
+				if(_stream_sizes[patch.slot] != size) {
+					return core::Err();
+				}
+			} else {
+				push_patch(patch);
+			}
+			return core::Ok(Success::Full);
+		}
+
+		size_type written_since(const SizePatch& patch) const {
+			return size_type(tell()) - size_type(patch.start);
+		}
+
+
+		// ------------------------------- COMPACT -------------------------------
+		Result write_varint(u64 value) {
+			std::array<u8, detail::max_varint_size> bytes;
+			return write_array(bytes.data(), detail::encode_varint(value, bytes.data()));
+		}
+
+		Result write_size(size_type size) {
+			if(_encoding == Encoding::Compact) {
+				return write_varint(size);
+			}
+			return write_one(size);
+		}
+
+		template<typename H>
+		Result write_header(const H& header) {
+			if(_encoding == Encoding::Fixed) {
+				return write_one(header);
+			}
+			return write_varint(header_index(detail::full_header(header)));
+		}
+
+		// Headers are collected by the measuring pass
+		u32 header_index(const detail::FullHeader& header) {
+			u64 key = header.type_id;
+			hash_combine(key, (u64(header.type.name_hash) << 32) | header.type.type_hash);
+			hash_combine(key, (u64(header.members.member_hash) << 32) | header.members.count);
+
+			if(const auto it = _header_indexes.find(key); it != _header_indexes.end()) {
+				if(detail::is_same_header(_headers[it->second], header)) {
+					return it->second;
+				}
+			}
+			// Hash collision
+			for(usize i = 0; i != _headers.size(); ++i) {
+				if(detail::is_same_header(_headers[i], header)) {
+					return u32(i);
+				}
+			}
+
+			y_debug_assert(_measuring);
+			const u32 index = u32(_headers.size());
+			_headers << header;
+			_header_indexes.emplace(key, index);
+			return index;
+		}
+
+		Result write_header_table() {
+			y_try(write_varint(_headers.size()));
+			for(const detail::FullHeader& header : _headers) {
+				y_try(write_one(header.type));
+				if(header.type.is_polymorphic()) {
+					y_try(write_one(header.type_id));
+				} else {
+#ifdef Y_SLIM_POD_HEADER
+					if(header.type.has_serde())
+#endif
+					{
+						y_try(write_one(header.members));
+					}
+				}
+			}
+			return core::Ok(Success::Full);
+		}
+
 		void push_patch(SizePatch patch) {
 			y_debug_assert(patch.index + patch.size <= tell());
 			y_debug_assert(patch.size < size_type(-1));
@@ -527,6 +970,9 @@ class WritableArchive final {
 
 	private:
 		File& _file;
+		const WriteMode _mode;
+		const Encoding _encoding;
+		usize _depth = 0;
 
 #ifdef Y_SERDE3_BUFFER
 		io2::Buffer _buffer;
@@ -534,6 +980,23 @@ class WritableArchive final {
 		usize _cached_file_size = 0;
 		core::Vector<SizePatch> _patches;
 
+		bool _measuring = false;
+		usize _measured_size = 0;
+		core::Vector<size_type> _stream_sizes;
+		usize _stream_cursor = 0;
+
+		core::Vector<detail::FullHeader> _headers;
+		core::ExternalHashMap<u64, u32> _header_indexes;
+
+		concurrent::StaticThreadPool* _thread_pool = nullptr;
+		usize _segment_size = detail::default_segment_size;
+
+		usize _toc_depth = 0;
+		usize _toc_level = 0;
+		usize _toc_start = 0;
+		u64 _toc_key = 0;
+		core::Vector<detail::TocEntry> _toc;
+
 		std::unique_ptr<File> _storage;
 };
 
@@ -552,27 +1015,74 @@ class ReadableArchive final {
 
 	static constexpr bool force_safe = false;
 
-	struct HeaderOffset {
-		detail::FullHeader header;
-		usize offset = 0;
-	};
+	// The read-ahead buffer starts small so that short archives don't read much past their end
+	static constexpr usize min_buffer_size = 4 * 1024;
+	static constexpr usize max_buffer_size = 64 * 1024;
 
-	struct ObjectData {
-		core::Vector<HeaderOffset> members;
-		usize end_offset = 0;
+	static constexpr u32 no_member = u32(-1);
+
+	struct PlanIndex {
+		usize offset = 0;
+		u32 count = 0;
 	};
 
 	public:
-		ReadableArchive(File& file) : _file(file) {
+		// Number of objects read, by how their members were matched, and of segments decoded on the pool
+		struct Stats {
+			usize exact_objects = 0;
+			usize planned_objects = 0;
+			usize pooled_segments = 0;
+		};
+
+		ReadableArchive(File& file, Encoding encoding = Encoding::Fixed) : _file(file), _encoding(encoding) {
+#ifdef Y_SERDE3_BUFFER
+			_buffer_offset = _file.tell();
+#endif
 		}
 
-		ReadableArchive(std::unique_ptr<File> file) : ReadableArchive(*file) {
+		ReadableArchive(std::unique_ptr<File> file, Encoding encoding = Encoding::Fixed) : ReadableArchive(*file, encoding) {
 			_storage = std::move(file);
 		}
 
+		const Stats& stats() const {
+			return _stats;
+		}
+
+		// Segmented collections are decoded on the pool when set, sequentially otherwise
+		void set_thread_pool(concurrent::StaticThreadPool* pool) {
+			_thread_pool = pool;
+		}
+
+		// Must match WritableArchive::set_table_of_contents
+		void set_table_of_contents(bool enabled) {
+			_has_toc = enabled;
+		}
+
+		// Only reads the object at path in the next root, using its table of contents.
+		// Paths are member names and collection indices separated by '/', like "items/12/name".
+		template<typename T, typename... Args>
+		Result deserialize_entry(std::string_view path, T& t, Args&&... args) {
+			y_debug_assert(!_depth);
+			++_depth;
+			Result res = deserialize_root_entry(path, t);
+			--_depth;
+			if(res) {
+				post_deserialize(t, y_fwd(args)...);
+			}
+			return res;
+		}
+
 		template<typename T, typename... Args>
 		Result deserialize(T& t, Args&&... args) {
-			auto res = deserialize_one(NamedObject{t, detail::version_string});
+			Result res = core::Err();
+			if(_depth) {
+				// Polymorphic objects deserialize themselves through here
+				res = deserialize_one(NamedObject{t, detail::version_string});
+			} else {
+				++_depth;
+				res = deserialize_root(t);
+				--_depth;
+			}
 			if(res) {
 				post_deserialize(t, y_fwd(args)...);
 			}
@@ -588,6 +1098,66 @@ class ReadableArchive final {
 
 
 	private:
+		template<typename T>
+		Result deserialize_root(T& t) {
+#ifdef Y_SERDE3_BUFFER
+			// The file might have been used directly since the last call
+			seek(_file.tell());
+#endif
+			Result res = core::Err();
+			if(_encoding == Encoding::Fixed || read_header_table()) {
+				if(_has_toc) {
+					size_type size = 0;
+					if(read_size(size)) {
+						const usize end = tell() + size;
+						res = deserialize_one(NamedObject{t, detail::version_string});
+						seek(end);
+						if(!skip_table_of_contents()) {
+							res = core::Err();
+						}
+					}
+				} else {
+					res = deserialize_one(NamedObject{t, detail::version_string});
+				}
+			}
+#ifdef Y_SERDE3_BUFFER
+			// Leave the file right after the object, not at the end of the read-ahead
+			_file.seek(tell());
+#endif
+			return res;
+		}
+
+		template<typename T>
+		Result deserialize_root_entry(std::string_view path, T& t) {
+			if(!_has_toc) {
+				return core::Err();
+			}
+#ifdef Y_SERDE3_BUFFER
+			seek(_file.tell());
+#endif
+			Result res = core::Err();
+			if(_encoding == Encoding::Fixed || read_header_table()) {
+				size_type size = 0;
+				if(read_size(size)) {
+					const usize start = tell();
+					seek(start + size);
+					usize offset = 0;
+					const bool found = find_entry(path, offset);
+					// Leave the reader after the root, like deserialize does
+					const usize end = tell();
+					if(found) {
+						seek(start + offset);
+						res = deserialize_one(NamedObject{t, entry_name(path)});
+					}
+					seek(end);
+				}
+			}
+#ifdef Y_SERDE3_BUFFER
+			_file.seek(tell());
+#endif
+			return res;
+		}
+
 		template<typename T, bool R>
 		Result deserialize_one(const NamedObject<T, R>& non_ref) {
 			NamedObject<T> object = non_ref.make_ref();
@@ -599,7 +1169,7 @@ class ReadableArchive final {
 				size_type size = size_type(-1);
 
 				y_try_discard(read_header(header));
-				y_try_discard(_file.read_one(size));
+				y_try_discard(read_object_size(header, size));
 
 				// this breaks if we return an error
 #if 0
@@ -613,6 +1183,10 @@ class ReadableArchive final {
 					return deserialize_object(object, header, size);
 				} else if constexpr(is_tuple_v<T>) {
 					return deserialize_tuple(object, header, size);
+				} else if constexpr(is_lazy_v<T>) {
+					return deserialize_lazy(object, header, size);
+				} else if constexpr(is_const_span_v<T>) {
+					return deserialize_span(object, header, size);
 				} else if constexpr(is_range_v<T>) {
 					return deserialize_range(object, header, size);
 				} else if constexpr(is_pod_v<T>) {
@@ -690,7 +1264,16 @@ class ReadableArchive final {
 			}
 
 			size_type collection_size = 0;
-			y_try(read_one(collection_size));
+			y_try(read_size(collection_size));
+
+			size_type segment_size = 0;
+			if(collection_size & detail::segmented_flag) {
+				collection_size &= ~detail::segmented_flag;
+				y_try(read_size(segment_size));
+				if(!segment_size) {
+					return core::Err();
+				}
+			}
 
 			if constexpr(IsRange) {
 				if(collection_size != object.object.size()) {
@@ -717,10 +1300,28 @@ class ReadableArchive final {
 								object.object.emplace_back();
 							}
 						}
-						y_try_discard(_file.read_array(object.object.begin(), collection_size));
+						y_try_discard(read_raw_array(object.object.begin(), collection_size));
 					}
 
 				} else {
+					if(segment_size) {
+						const usize segment_count = usize((collection_size + segment_size - 1) / segment_size);
+						if constexpr((has_resize_v<T> || has_emplace_back_v<T>) && detail::use_collection_segments<T>) {
+							if(_thread_pool) {
+								const usize table = tell();
+								bool borrowed = false;
+								y_try(deserialize_segments(object.object, usize(collection_size), usize(segment_size), segment_count, borrowed));
+								if(!borrowed) {
+									return core::Ok(Success::Full);
+								}
+								object.object = T();
+								seek(table);
+							}
+						}
+						// Items are stored one after the other, the segment table can be ignored
+						seek(tell() + segment_count * sizeof(size_type));
+					}
+
 					if constexpr(has_reserve_v<T>) {
 						object.object.reserve(collection_size);
 					}
@@ -761,6 +1362,122 @@ class ReadableArchive final {
 			}
 		}
 
+		// Segments are copied and decoded on the pool. borrowed is set if an item needs to be read from
+		// _file itself (ex: a poly object holding a mapped span), in which case the collection must be read again.
+		template<typename T>
+		Result deserialize_segments(T& collection, usize size, usize segment_size, usize segment_count, bool& borrowed) {
+			auto segments = std::make_unique<detail::Segment[]>(segment_count);
+			{
+				core::Vector<size_type> byte_sizes;
+				for(usize s = 0; s != segment_count; ++s) {
+					size_type byte_size = 0;
+					y_try(read_size(byte_size));
+					byte_sizes << byte_size;
+				}
+				for(usize s = 0; s != segment_count; ++s) {
+					y_try(read_into(segments[s].buffer, usize(byte_sizes[s])));
+					segments[s].buffer.reset();
+				}
+			}
+
+			if constexpr(has_resize_v<T>) {
+				collection.resize(size);
+			} else {
+				if constexpr(has_reserve_v<T>) {
+					collection.reserve(size);
+				}
+				while(collection.size() < size) {
+					collection.emplace_back();
+				}
+			}
+			auto* items = collection.begin();
+
+			concurrent::DependencyGroup group;
+			for(usize s = 0; s != segment_count; ++s) {
+				_thread_pool->schedule([&segments, items, size, segment_size, s] {
+					ReadableArchive arc(segments[s].buffer);
+					++arc._depth;
+					arc._detached = true;
+					const usize end = std::min(size, (s + 1) * segment_size);
+					for(usize i = s * segment_size; i != end; ++i) {
+						if(!arc.deserialize_one(NamedObject{items[i], detail::collection_version_string})) {
+							segments[s].borrowed = arc._borrowed;
+							return;
+						}
+					}
+					segments[s].ok = true;
+				}, &group);
+			}
+			_thread_pool->wait_for(group);
+
+			for(usize s = 0; s != segment_count; ++s) {
+				if(segments[s].borrowed) {
+					borrowed = true;
+					return core::Ok(Success::Full);
+				}
+			}
+			for(usize s = 0; s != segment_count; ++s) {
+				if(!segments[s].ok) {
+					return core::Err();
+				}
+			}
+			_stats.pooled_segments += segment_count;
+			return core::Ok(Success::Full);
+		}
+
+
+		// ------------------------------- SPAN -------------------------------
+		// Spans of const POD point directly into the reader's mapped_data(), which must outlive them.
+		// Fails if the reader isn't mapped or if the elements are not correctly aligned in it.
+		template<typename T>
+		Result deserialize_span(NamedObject<T> object, const detail::FullHeader& header, size_type size) {
+			using value_type = typename T::value_type;
+			static_assert(detail::use_collection_fast_path<T>, "Only spans of trivially copyable types can be deserialized");
+
+			object.object = T();
+
+			if(_detached) {
+				_borrowed = true;
+				return core::Err();
+			}
+
+			const usize end = tell() + size;
+			const auto check = detail::build_header(object);
+			if(header != check) {
+				seek(end);
+				return core::Ok(Success::Partial);
+			}
+
+			size_type collection_size = 0;
+			y_try(read_size(collection_size));
+			if(!collection_size) {
+				return core::Ok(Success::Full);
+			}
+
+			// The span is still empty, so the item header is built from a placeholder
+			value_type item = {};
+			detail::FullHeader item_header;
+			y_try_discard(read_header(item_header));
+			if(item_header != detail::build_header(NamedObject{item, detail::collection_version_string})) {
+				seek(end);
+				return core::Ok(Success::Partial);
+			}
+
+			const u8* data = _file.mapped_data();
+			const usize offset = tell();
+			if(!data || offset > end || (end - offset) / sizeof(value_type) < collection_size) {
+				return core::Err();
+			}
+			if(usize(data + offset) % alignof(value_type)) {
+				return core::Err();
+			}
+
+			object.object = T(reinterpret_cast<value_type*>(data + offset), usize(collection_size));
+			seek(offset + usize(collection_size) * sizeof(value_type));
+			return core::Ok(Success::Full);
+		}
+
+
 		// ------------------------------- POLY -------------------------------
 		template<typename T>
 		Result deserialize_poly(NamedObject<T> object, const detail::FullHeader& header, size_type size) {
@@ -788,11 +1505,15 @@ class ReadableArchive final {
 			static_assert(!std::is_pointer_v<T>);
 
 			const auto check = detail::build_header(object);
+			if(_encoding == Encoding::Compact && detail::is_packed_integer(header.type)) {
+				return deserialize_packed_integer(object, header);
+			}
+
 			if(header != check) {
 				static constexpr usize max_prim_size = 4 * sizeof(float);
 				if(header.type.name_hash == check.type.name_hash && size <= max_prim_size) {
 					std::array<u8, max_prim_size> buffer;
-					y_try_discard(_file.read(buffer.data(), size));
+					y_try_discard(read_bytes(buffer.data(), size));
 					return try_convert<T>(object.object, header.type, buffer.data());
 				} else {
 					seek(tell() + size);
@@ -804,80 +1525,235 @@ class ReadableArchive final {
 		}
 
 
+		template<typename T>
+		Result deserialize_packed_integer(NamedObject<T> object, const detail::FullHeader& header) {
+			u64 packed = 0;
+			y_try(read_varint(packed));
+
+			u64 value = 0;
+			detail::unpack_integer(header.type, packed, &value);
+			if(header == detail::build_header(object)) {
+				std::memcpy(&object.object, &value, sizeof(T));
+				return core::Ok(Success::Full);
+			}
+			if(header.type.name_hash == detail::build_header(object).type.name_hash) {
+				return try_convert<T>(object.object, header.type, &value);
+			}
+			return core::Ok(Success::Partial);
+		}
+
+
 		// ------------------------------- OBJECT -------------------------------
 		template<typename T>
 		Result deserialize_object(NamedObject<T> object, const detail::FullHeader& header, size_type) {
 			static_assert(has_serde3_v<T>);
 			static_assert(!has_serde3_poly_v<T>);
 
-			const auto check = detail::build_header(object);
-			if(header != check) {
+			// The members header only depends on the type, no need to rehash the members for every object.
+			// The name depends on where the object is, so it's checked every time.
+			static const detail::MembersHeader members = detail::build_members_header(object);
+			const detail::ObjectHeader check = {detail::build_type_header(object), members};
+			if(header != check || force_safe) {
 				if(header.type.type_hash != check.type.type_hash) {
 					return core::Err();
 				}
-				return deserialize_members<true>(object.object, header.members.count);
+				++_stats.planned_objects;
+				return deserialize_members_planned(object.object, header);
 			} else {
-				return deserialize_members<force_safe>(object.object, header.members.count);
+				++_stats.exact_objects;
+				return deserialize_members<0>(object.object._y_serde3_refl());
 			}
 		}
 
-		template<bool Safe, usize I, typename... Args, bool... Refs>
-		Result deserialize_members_internal(const std::tuple<NamedObject<Args, Refs>...>& members,
-											const ObjectData& object_data) {
-			unused(members, object_data);
-
+		// Exact match: members are stored in order
+		template<usize I, typename... Args, bool... Refs>
+		Result deserialize_members(const std::tuple<NamedObject<Args, Refs>...>& members) {
 			Success status = Success::Full;
 			if constexpr(I < sizeof...(Args)) {
-				if constexpr(Safe) {
-					bool found = false;
-					const auto header = detail::build_header(std::get<I>(members));
-					for(const auto& m : object_data.members) {
-						if(m.header.type.name_hash == header.type.name_hash) {
-							seek(m.offset);
-							y_try_status(deserialize_one(std::get<I>(members)));
-							found = true;
-							break;
-						}
-					}
-					if(!found) {
-						status = Success::Partial;
-					}
-				} else {
-					y_try_status(deserialize_one(std::get<I>(members)));
+				y_try_status(deserialize_one(std::get<I>(members)));
+				y_try_status((deserialize_members<I + 1>(members)));
+			} else {
+				unused(members);
+			}
+			return core::Ok(status);
+		}
+
+		template<usize I, typename... Args, bool... Refs>
+		Result deserialize_member_at(const std::tuple<NamedObject<Args, Refs>...>& members, usize index) {
+			if constexpr(I < sizeof...(Args)) {
+				if(index == I) {
+					return deserialize_one(std::get<I>(members));
 				}
+				return deserialize_member_at<I + 1>(members, index);
+			} else {
+				unused(members, index);
+				return core::Err();
+			}
+		}
 
-				y_try_status((deserialize_members_internal<Safe, I + 1>(members, object_data)));
-			} else if constexpr(Safe) {
-				seek(object_data.end_offset);
+		// Members are matched by name, the mapping is computed once per stored layout
+		template<typename T>
+		Result deserialize_members_planned(T& object, const detail::FullHeader& header) {
+			const auto members = object._y_serde3_refl();
+			constexpr usize member_count = std::tuple_size_v<decltype(members)>;
+
+			usize plan = 0;
+			y_try_discard(member_plan(members, header, plan));
+
+			Success status = Success::Full;
+			usize found = 0;
+			for(usize i = 0; i != header.members.count; ++i) {
+				const usize member_start = tell();
+
+				detail::FullHeader member_header;
+				size_type size = size_type(-1);
+				y_try_discard(read_header(member_header));
+				y_try_discard(read_object_size(member_header, size));
+				const usize member_end = tell() + size;
+
+				const u32 index = _member_plans[plan + i];
+				if(index != no_member) {
+					seek(member_start);
+					y_try_status(deserialize_member_at<0>(members, index));
+					++found;
+				}
+				seek(member_end);
 			}
 
+			if(found != member_count) {
+				status = Success::Partial;
+			}
 			return core::Ok(status);
 		}
 
-		template<bool Safe, typename T>
-		Result deserialize_members(T& object, usize serialized_member_count) {
-			ObjectData data;
+		// Finds or builds the plan: for each stored member, the index of the matching member or no_member
+		template<typename... Args, bool... Refs>
+		Result member_plan(const std::tuple<NamedObject<Args, Refs>...>& members, const detail::FullHeader& header, usize& plan) {
+			const u64 key = (u64(header.type.type_hash) << 32) | header.members.member_hash;
+			if(const auto it = _plan_indexes.find(key); it != _plan_indexes.end()) {
+				y_debug_assert(it->second.count == header.members.count);
+				plan = it->second.offset;
+				return core::Ok(Success::Full);
+			}
 
-			if constexpr(Safe) {
-				usize obj_start = tell();
-				for(usize i = 0; i != serialized_member_count; ++i) {
-					usize offset = tell();
+			const usize start = tell();
+			core::Vector<u32> name_hashes;
+			for(usize i = 0; i != header.members.count; ++i) {
+				detail::FullHeader member_header;
+				size_type size = size_type(-1);
+				y_try_discard(read_header(member_header));
+				y_try_discard(read_object_size(member_header, size));
+				seek(tell() + size);
+				name_hashes << member_header.type.name_hash;
+			}
+			seek(start);
 
-					detail::FullHeader header;
-					size_type size = size_type(-1);
+			plan = _member_plans.size();
+			for(usize i = 0; i != header.members.count; ++i) {
+				_member_plans << no_member;
+			}
 
-					y_try_discard(read_header(header));
-					y_try_discard(_file.read_one(size));
+			const std::array<u32, sizeof...(Args)> member_hashes = std::apply([](const auto&... m) {
+				return std::array<u32, sizeof...(Args)>{detail::ct_str_hash(m.name)...};
+			}, members);
+			for(usize m = 0; m != member_hashes.size(); ++m) {
+				for(usize i = 0; i != name_hashes.size(); ++i) {
+					if(name_hashes[i] == member_hashes[m] && _member_plans[plan + i] == no_member) {
+						_member_plans[plan + i] = u32(m);
+						break;
+					}
+				}
+			}
+
+			_plan_indexes.emplace(key, PlanIndex{plan, header.members.count});
+			return core::Ok(Success::Full);
+		}
+
+
+		// ------------------------------- LAZY -------------------------------
+		// Only remembers where the value is
+		template<typename T>
+		Result deserialize_lazy(NamedObject<T> object, const detail::FullHeader& header, size_type size) {
+			const usize start = tell();
+			seek(start + size);
+			if(header != detail::build_header(object)) {
+				return core::Ok(Success::Partial);
+			}
+			object.object.set_source(_file, start, _encoding);
+			if(_detached) {
+				// The copy of the segment doesn't outlive this archive
+				Result result = object.object.load();
+				object.object._reader = nullptr;
+				return result;
+			}
+			return core::Ok(Success::Full);
+		}
 
-					seek(tell() + size);
 
-					data.members << HeaderOffset{header, offset};
+		// ------------------------------- TOC -------------------------------
+		// Leaves the reader at the end of the table
+		bool find_entry(std::string_view path, usize& offset) {
+			u64 key = 0;
+			while(!path.empty()) {
+				const usize sep = path.find('/');
+				const std::string_view component = path.substr(0, sep);
+				path = sep == std::string_view::npos ? std::string_view() : path.substr(sep + 1);
+
+				usize index = 0;
+				if(parse_index(component, index)) {
+					key = detail::toc_index_key(key, index);
+				} else {
+					key = detail::toc_name_key(key, component);
+				}
+			}
+
+			size_type count = 0;
+			if(!read_size(count)) {
+				return false;
+			}
+			bool found = false;
+			for(size_type i = 0; i != count; ++i) {
+				detail::TocEntry entry;
+				if(!read_raw(entry)) {
+					return false;
+				}
+				if(!found && entry.key == key) {
+					offset = usize(entry.offset);
+					found = true;
+				}
+			}
+			return found;
+		}
+
+		bool skip_table_of_contents() {
+			size_type count = 0;
+			if(!read_size(count)) {
+				return false;
+			}
+			seek(tell() + usize(count) * sizeof(detail::TocEntry));
+			return true;
+		}
+
+		static bool parse_index(std::string_view component, usize& index) {
+			if(component.empty()) {
+				return false;
+			}
+			index = 0;
+			for(const char c : component) {
+				if(c < '0' || c > '9') {
+					return false;
 				}
-				data.end_offset = tell();
-				seek(obj_start);
+				index = index * 10 + usize(c - '0');
 			}
+			return true;
+		}
 
-			return deserialize_members_internal<Safe, 0>(object._y_serde3_refl(), data);
+		// Objects are named after their member, or are collection items
+		static std::string_view entry_name(std::string_view path) {
+			const usize sep = path.rfind('/');
+			const std::string_view name = sep == std::string_view::npos ? path : path.substr(sep + 1);
+			usize index = 0;
+			return parse_index(name, index) ? detail::collection_version_string : name;
 		}
 
 
@@ -972,40 +1848,291 @@ class ReadableArchive final {
 
 
 		// ------------------------------- READ -------------------------------
+		io2::ReadResult read_bytes(void* data, usize bytes) {
+#ifdef Y_SERDE3_BUFFER
+			const usize available = _buffer_end - _buffer_pos;
+			if(bytes <= available) {
+				std::memcpy(data, _buffer.get() + _buffer_pos, bytes);
+				_buffer_pos += bytes;
+				return core::Ok();
+			}
+
+			u8* out = static_cast<u8*>(data);
+			if(available) {
+				std::memcpy(out, _buffer.get() + _buffer_pos, available);
+				out += available;
+				bytes -= available;
+			}
+
+			// Large reads bypass the buffer
+			_buffer_offset += _buffer_end;
+			_buffer_pos = _buffer_end = 0;
+			if(bytes >= max_buffer_size / 2) {
+				_file.seek(_buffer_offset);
+				_buffer_offset += bytes;
+				return _file.read(out, bytes);
+			}
+
+			fill_buffer();
+			if(bytes > _buffer_end) {
+				return core::Err(available + _buffer_end);
+			}
+			std::memcpy(out, _buffer.get(), bytes);
+			_buffer_pos = bytes;
+			return core::Ok();
+#else
+			return _file.read(data, bytes);
+#endif
+		}
+
+		template<typename T>
+		io2::ReadResult read_raw(T& t) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			return read_bytes(&t, sizeof(T));
+		}
+
+		// Copies the next bytes into buffer
+		Result read_into(io2::Buffer& buffer, usize bytes) {
+			std::array<u8, 4096> chunk;
+			while(bytes) {
+				const usize count = std::min(bytes, chunk.size());
+				y_try_discard(read_bytes(chunk.data(), count));
+				y_try_discard(buffer.write(chunk.data(), count));
+				bytes -= count;
+			}
+			return core::Ok(Success::Full);
+		}
+
+		template<typename T>
+		io2::ReadResult read_raw_array(T* data, usize count) {
+			static_assert(std::is_trivially_copyable_v<T>);
+			return read_bytes(data, sizeof(T) * count);
+		}
+
+#ifdef Y_SERDE3_BUFFER
+		// Reads the bytes following the current buffer
+		void fill_buffer() {
+			y_debug_assert(_buffer_pos == _buffer_end);
+			if(_buffer_capacity < max_buffer_size) {
+				_buffer_capacity = _buffer ? _buffer_capacity * 2 : min_buffer_size;
+				_buffer = std::unique_ptr<u8[]>(new u8[_buffer_capacity]);
+			}
+
+			_buffer_offset += _buffer_end;
+			_buffer_pos = _buffer_end = 0;
+			_file.seek(_buffer_offset);
+			if(const auto r = _file.read_up_to(_buffer.get(), _buffer_capacity)) {
+				_buffer_end = r.unwrap();
+			}
+		}
+#endif
+
 		template<typename T>
 		Result read_one(T& t) {
 			static_assert(!std::is_same_v<std::remove_reference_t<T>, detail::FullHeader>);
-			y_try_discard(_file.read_one(t));
+			y_try_discard(read_raw(t));
 			return core::Ok(Success::Full);
 		}
 
 		Result read_header(detail::FullHeader& header) {
-			y_try_discard(_file.read_one(header.type));
+			if(_encoding == Encoding::Compact) {
+				u64 index = 0;
+				y_try(read_varint(index));
+				if(index >= _headers.size()) {
+					return core::Err();
+				}
+				header = _headers[usize(index)];
+				return core::Ok(Success::Full);
+			}
+			return read_full_header(header);
+		}
+
+		Result read_full_header(detail::FullHeader& header) {
+			y_try_discard(read_raw(header.type));
 			if(header.type.is_polymorphic()) {
-				y_try_discard(_file.read_one(header.type_id));
+				y_try_discard(read_raw(header.type_id));
 			} else {
 				bool read_members = true;
 #ifdef Y_SLIM_POD_HEADER
 				read_members = header.type.has_serde();
 #endif
 				if(read_members) {
-					y_try_discard(_file.read_one(header.members));
+					y_try_discard(read_raw(header.members));
 				}
 			}
 			return core::Ok(Success::Full);
 		}
 
+		Result read_varint(u64& value) {
+			value = 0;
+			for(usize shift = 0; shift < 64; shift += 7) {
+				u8 byte = 0;
+				y_try_discard(read_raw(byte));
+				value |= u64(byte & 0x7F) << shift;
+				if(!(byte & 0x80)) {
+					return core::Ok(Success::Full);
+				}
+			}
+			return core::Err();
+		}
+
+		Result read_size(size_type& size) {
+			if(_encoding == Encoding::Compact) {
+				return read_varint(size);
+			}
+			return read_one(size);
+		}
+
+		// Packed integers have no size, we return the size of their encoding so they can be skipped
+		Result read_object_size(const detail::FullHeader& header, size_type& size) {
+			if(_encoding == Encoding::Compact && detail::is_packed_integer(header.type)) {
+				const usize start = tell();
+				u64 value = 0;
+				y_try(read_varint(value));
+				size = tell() - start;
+				seek(start);
+				return core::Ok(Success::Full);
+			}
+			return read_size(size);
+		}
+
+		Result read_header_table() {
+			_headers.make_empty();
+			u64 count = 0;
+			y_try(read_varint(count));
+			for(u64 i = 0; i != count; ++i) {
+				detail::FullHeader header;
+				y_try(read_full_header(header));
+				_headers << header;
+			}
+			return core::Ok(Success::Full);
+		}
+
 		usize tell() const {
+#ifdef Y_SERDE3_BUFFER
+			return _buffer_offset + _buffer_pos;
+#else
 			return _file.tell();
+#endif
 		}
 
+		// Seeking inside the buffer does not touch the file
 		void seek(usize offset) {
+#ifdef Y_SERDE3_BUFFER
+			if(offset >= _buffer_offset && offset <= _buffer_offset + _buffer_end) {
+				_buffer_pos = offset - _buffer_offset;
+			} else {
+				_buffer_offset = offset;
+				_buffer_pos = _buffer_end = 0;
+			}
+#else
 			_file.seek(offset);
+#endif
 		}
 
 	private:
 		File& _file;
 		std::unique_ptr<File> _storage;
+
+		const Encoding _encoding;
+		usize _depth = 0;
+		core::Vector<detail::FullHeader> _headers;
+
+		// Member mappings of objects stored with a different layout, keyed by type and members hash
+		core::ExternalHashMap<u64, PlanIndex> _plan_indexes;
+		core::Vector<u32> _member_plans;
+
+		concurrent::StaticThreadPool* _thread_pool = nullptr;
+		bool _has_toc = false;
+
+		// Set for archives reading a copy of a segment: lazy values are loaded right away and mapped spans
+		// can't be read, which sets _borrowed so that the segments are read again from _file.
+		bool _detached = false;
+		bool _borrowed = false;
+
+		Stats _stats;
+
+#ifdef Y_SERDE3_BUFFER
+		// The buffer holds the bytes [_buffer_offset, _buffer_offset + _buffer_end) of the file
+		std::unique_ptr<u8[]> _buffer;
+		usize _buffer_capacity = 0;
+		usize _buffer_offset = 0;
+		usize _buffer_pos = 0;
+		usize _buffer_end = 0;
+#endif
+};
+
+
+
+
+// Deserializes its value on first access, from the reader of the archive it was read from, which must outlive it.
+// The value is stored as a nested archive and is post deserialized without arguments.
+// Values inside collection segments decoded on a thread pool are loaded right away.
+// Loading always reads the whole value, the table of contents doesn't locate parts of it.
+template<typename T>
+class Lazy {
+	public:
+		Lazy() = default;
+
+		Lazy(T value) : _value(std::move(value)) {
+		}
+
+		bool is_loaded() const {
+			return _value.has_value();
+		}
+
+		Result load() const {
+			if(_value) {
+				return core::Ok(Success::Full);
+			}
+
+			y_debug_assert(_reader);
+			const usize pos = _reader->tell();
+			_reader->seek(_offset);
+
+			T value;
+			ReadableArchive arc(*_reader, _encoding);
+			Result res = arc.deserialize(value);
+			_reader->seek(pos);
+			if(res) {
+				_value = std::move(value);
+			}
+			return res;
+		}
+
+		const T& get() const {
+			y_always_assert(load(), "Unable to load lazy value");
+			return *_value;
+		}
+
+		T& get() {
+			y_always_assert(load(), "Unable to load lazy value");
+			return *_value;
+		}
+
+		const T* operator->() const {
+			return &get();
+		}
+
+		T* operator->() {
+			return &get();
+		}
+
+	private:
+		friend class ReadableArchive;
+
+		void set_source(io2::Reader& reader, usize offset, Encoding encoding) {
+			_value.reset();
+			_reader = &reader;
+			_offset = offset;
+			_encoding = encoding;
+		}
+
+		mutable std::optional<T> _value = T();
+
+		io2::Reader* _reader = nullptr;
+		usize _offset = 0;
+		Encoding _encoding = Encoding::Fixed;
 };
 
 }
@@ -0,0 +1,119 @@
+/*******************************
+Copyright (c) 2016-2020 Grégoire Angerand
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+**********************************/
+#ifndef Y_SERDE3_COMPACT_H
+#define Y_SERDE3_COMPACT_H
+
+#include "headers.h"
+
+#include <cstring>
+
+namespace y {
+namespace serde3 {
+
+// Fixed writes headers and sizes as is.
+// Compact writes the headers once per serialized root, in a table referenced by LEB128 indices,
+// and writes sizes, counts and integers as LEB128 (zigzag encoded for signed integers).
+// Archives must be read with the encoding they were written with.
+enum class Encoding {
+	Fixed,
+	Compact
+};
+
+namespace detail {
+
+static constexpr usize max_varint_size = 10;
+
+constexpr usize varint_size(u64 value) {
+	usize size = 1;
+	while(value >>= 7) {
+		++size;
+	}
+	return size;
+}
+
+inline usize encode_varint(u64 value, u8* out) {
+	usize size = 0;
+	do {
+		out[size] = u8(value & 0x7F);
+		value >>= 7;
+		if(value) {
+			out[size] |= 0x80;
+		}
+		++size;
+	} while(value);
+	return size;
+}
+
+template<typename T>
+static constexpr bool is_packed_integer_v =
+		std::is_same_v<T, u8> || std::is_same_v<T, u16> || std::is_same_v<T, u32> || std::is_same_v<T, u64> ||
+		std::is_same_v<T, i8> || std::is_same_v<T, i16> || std::is_same_v<T, i32> || std::is_same_v<T, i64>;
+
+template<typename T>
+u64 pack_integer(T value) {
+	static_assert(is_packed_integer_v<T>);
+	if constexpr(std::is_signed_v<T>) {
+		const i64 v = value;
+		return (u64(v) << 1) ^ u64(v >> 63);
+	} else {
+		return u64(value);
+	}
+}
+
+template<typename T>
+T unpack_integer(u64 value) {
+	static_assert(is_packed_integer_v<T>);
+	if constexpr(std::is_signed_v<T>) {
+		return T(i64(value >> 1) ^ -i64(value & 0x01));
+	} else {
+		return T(value);
+	}
+}
+
+template<typename T>
+bool unpack_integer_as(TypeHeader type, u64 value, void* out) {
+	if(header_type_hash<T>() != type.type_hash) {
+		return false;
+	}
+	const T t = unpack_integer<T>(value);
+	std::memcpy(out, &t, sizeof(T));
+	return true;
+}
+
+// Writes the integer described by type in its native representation
+inline bool unpack_integer(TypeHeader type, u64 value, void* out) {
+	return unpack_integer_as<u8>(type, value, out) || unpack_integer_as<u16>(type, value, out) ||
+	       unpack_integer_as<u32>(type, value, out) || unpack_integer_as<u64>(type, value, out) ||
+	       unpack_integer_as<i8>(type, value, out) || unpack_integer_as<i16>(type, value, out) ||
+	       unpack_integer_as<i32>(type, value, out) || unpack_integer_as<i64>(type, value, out);
+}
+
+inline bool is_packed_integer(TypeHeader type) {
+	u64 unused_value = 0;
+	return unpack_integer(type, 0, &unused_value);
+}
+
+}
+}
+}
+
+#endif // Y_SERDE3_COMPACT_H
@@ -25,6 +25,9 @@ SOFTWARE.
 #include <y/utils/name.h>
 #include <y/utils/hash.h>
 
+#include <y/core/Span.h>
+#include <y/core/Vector.h>
+
 #include "serde.h"
 #include "poly.h"
 
@@ -34,7 +37,7 @@ namespace y {
 namespace serde3 {
 
 namespace detail {
-template<typename T>
+template<typename T, typename = void>
 struct Deconst {
 	using type = remove_cvref_t<T>;
 };
@@ -48,6 +51,16 @@ template<typename A, typename B>
 struct Deconst<std::pair<A, B>> {
 	using type = std::pair<remove_cvref_t<A>, remove_cvref_t<B>>;
 };
+
+// Spans of raw items share their header with vectors so that one can be loaded as the other.
+// Other spans keep their own header so that existing archives stay readable.
+template<typename T>
+struct Deconst<core::MutableSpan<T>, std::enable_if_t<
+		std::is_trivially_copyable_v<std::remove_const_t<T>> &&
+		!has_serde3_v<std::remove_const_t<T>> &&
+		!std::is_pointer_v<std::remove_const_t<T>>>> {
+	using type = core::Vector<std::remove_const_t<T>>;
+};
 }
 
 template<typename T>
@@ -123,7 +136,7 @@ struct ObjectHeader {
 struct FullHeader {
 	TypeHeader type;
 	MembersHeader members;
-	TypeId type_id;
+	TypeId type_id = 0;
 
 	constexpr bool operator==(const TrivialHeader& other) const {
 		return type == other.type;
@@ -143,6 +156,22 @@ struct FullHeader {
 	}
 };
 
+constexpr FullHeader full_header(const TrivialHeader& header) {
+	return FullHeader{header.type, {}, 0};
+}
+
+constexpr FullHeader full_header(const ObjectHeader& header) {
+	return FullHeader{header.type, header.members, 0};
+}
+
+constexpr FullHeader full_header(const PolyHeader& header) {
+	return FullHeader{header.type, {}, header.type_id};
+}
+
+constexpr bool is_same_header(const FullHeader& a, const FullHeader& b) {
+	return a.type == b.type && a.members == b.members && a.type_id == b.type_id;
+}
+
 static_assert(sizeof(TypeHeader) == sizeof(u64));
 static_assert(sizeof(MembersHeader) == sizeof(u64));
 
@@ -29,6 +29,11 @@ SOFTWARE.
 #include <y/utils/hash.h>
 
 #include <memory>
+#include <functional>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace y {
 namespace serde3 {
@@ -62,23 +67,120 @@ struct PolyType {
 	};
 
 	inline static Type* first = nullptr;
+	inline static std::atomic<usize> type_count = 0;
+
+	// Open addressing tables of the first type_count() registered types, never modified once built
+	// so reads don't need any synchronization.
+	class Index {
+		public:
+			Index(usize count) : _type_count(count) {
+				usize size = 16;
+				while(size < count * 2) {
+					size *= 2;
+					++_bits;
+				}
+				_by_id = std::make_unique<const Type*[]>(size);
+				_by_name = std::make_unique<const Type*[]>(size);
+
+				// Types are pushed in front of the list, so the oldest ones are at the end
+				usize skipped = registered_type_count() - count;
+				for(const Type* t = first; t; t = t->next) {
+					if(skipped) {
+						--skipped;
+						continue;
+					}
+					insert(_by_id.get(), t->type_id, t);
+					insert(_by_name.get(), name_hash(t->name), t);
+				}
+			}
 
-	static std::unique_ptr<Base> create_from_id(TypeId id) {
-		for(auto* t = first; t; t = t->next) {
-			if(t->type_id == id) {
-				return t->create();
+			usize type_count() const {
+				return _type_count;
+			}
+
+			const Type* find_id(TypeId id) const {
+				for(usize i = slot(id);; i = next_slot(i)) {
+					const Type* t = _by_id[i];
+					if(!t || t->type_id == id) {
+						return t;
+					}
+				}
+			}
+
+			const Type* find_name(std::string_view name) const {
+				for(usize i = slot(name_hash(name));; i = next_slot(i)) {
+					const Type* t = _by_name[i];
+					if(!t || t->name == name) {
+						return t;
+					}
+				}
+			}
+
+		private:
+			static u64 name_hash(std::string_view name) {
+				return std::hash<std::string_view>()(name);
 			}
+
+			usize slot(u64 hash) const {
+				return usize((hash * 0x9e3779b97f4a7c15) >> (64 - _bits));
+			}
+
+			usize next_slot(usize i) const {
+				return (i + 1) & ((usize(1) << _bits) - 1);
+			}
+
+			void insert(const Type** table, u64 hash, const Type* type) {
+				usize i = slot(hash);
+				while(table[i]) {
+					i = next_slot(i);
+				}
+				table[i] = type;
+			}
+
+			std::unique_ptr<const Type*[]> _by_id;
+			std::unique_ptr<const Type*[]> _by_name;
+			usize _bits = 4;
+			usize _type_count = 0;
+	};
+
+	// Built by the first lookup and rebuilt by the first lookup following a registration.
+	// Replaced indexes are kept alive since other threads might still be reading them.
+	static const Index& index() {
+		static std::atomic<const Index*> current = nullptr;
+
+		const usize count = type_count.load(std::memory_order_acquire);
+		if(const Index* idx = current.load(std::memory_order_acquire); idx && idx->type_count() == count) {
+			return *idx;
+		}
+
+		static std::mutex lock;
+		static std::vector<std::unique_ptr<const Index>> indexes;
+
+		const std::unique_lock guard(lock);
+		const Index* idx = current.load(std::memory_order_relaxed);
+		if(!idx || idx->type_count() != count) {
+			idx = indexes.emplace_back(std::make_unique<const Index>(count)).get();
+			current.store(idx, std::memory_order_release);
 		}
-		return nullptr;
+		return *idx;
+	}
+
+	static const Type* find_type(TypeId id) {
+		return index().find_id(id);
+	}
+
+	static const Type* find_type(std::string_view name) {
+		return index().find_name(name);
+	}
+
+	static std::unique_ptr<Base> create_from_id(TypeId id) {
+		const Type* t = find_type(id);
+		return t ? t->create() : nullptr;
 	}
 
 	static std::unique_ptr<Base> create_from_name(std::string_view name) {
-		for(auto* t = first; t; t = t->next) {
-			if(t->name == name) {
-				return t->create();
-			}
-		}
-		return nullptr;
+		const Type* t = find_type(name);
+		return t ? t->create() : nullptr;
 	}
 
 	template<typename Derived>
@@ -93,14 +195,11 @@ struct PolyType {
 			ct_type_name<Derived>()
 		};
 		first = &type;
+		type_count.fetch_add(1, std::memory_order_release);
 	}
 
 	static usize registered_type_count() {
-		usize i = 0;
-		for(auto* t = first; t; t = t->next) {
-			++i;
-		}
-		return i;
+		return type_count.load(std::memory_order_acquire);
 	}
 };
 
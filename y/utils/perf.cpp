@@ -245,6 +245,24 @@ void event(const char* cat, const char* name) {
 	thread_data()->write(b, len);
 }
 
+void counter(const char* cat, const char* name, core::Span<CounterValue> values) {
+	if(!is_capturing()) {
+		return;
+	}
+	char b[print_buffer_len * 4];
+	usize len = std::snprintf(b, sizeof(b), R"({"name":"%s","cat":"%s","ph":"C","pid":0,"tid":%u,"ts":%.1f,"args":{)", name, cat, concurrent::thread_id(), micros());
+	for(usize i = 0; i != values.size() && len < sizeof(b); ++i) {
+		len += std::snprintf(b + len, sizeof(b) - len, R"(%s"%s":%llu)", i ? "," : "", values[i].name, static_cast<unsigned long long>(values[i].value));
+	}
+	if(len < sizeof(b)) {
+		len += std::snprintf(b + len, sizeof(b) - len, "}},");
+	}
+	if(len >= sizeof(b)) {
+		y_fatal("Too long.");
+	}
+	thread_data()->write(b, len);
+}
+
 
 #else
 void start_capture(const char*) {}
@@ -253,6 +271,7 @@ bool is_capturing() { return false; }
 void enter(const char*, const char*) {}
 void leave(const char*, const char*) {}
 void event(const char*, const char*) {}
+void counter(const char*, const char*, core::Span<CounterValue>) {}
 #endif
 
 }
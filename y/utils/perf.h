@@ -23,6 +23,7 @@ SOFTWARE.
 #define Y_UTILS_PERF_H
 
 #include <y/utils.h>
+#include <y/core/Span.h>
 
 namespace y {
 namespace perf {
@@ -39,6 +40,14 @@ void enter(const char* cat, const char* func);
 void leave(const char* cat, const char* func);
 void event(const char* cat, const char* name);
 
+struct CounterValue {
+	const char* name = nullptr;
+	u64 value = 0;
+};
+
+// Names must be valid JSON strings (no escaping is done)
+void counter(const char* cat, const char* name, core::Span<CounterValue> values);
+
 inline auto log_func(const char* func, const char* cat = "") {
 	class Logger : NonCopyable {
 		const char* _cat;